@@ -0,0 +1,220 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+// flashlogd: drains the shared memory rings of every process started with
+// FlashLogger.shm_name = <prefix> into one merged sink.
+//
+// Design note:
+// # - rings are discovered under /dev/shm as "<prefix>.<pid>" and attached read/write.
+// # - the head record of every ring is held (slot locked) and the oldest one by header
+//     time is written first, so the merged file is ordered across processes.
+// # - a ring whose owner is gone is drained to the end and then unlinked, so lines
+//     committed before a crash are kept.
+
+#include <iostream>
+#include <csignal>
+#include <cerrno>
+#include <dirent.h>
+#include <thread>
+#include <vector>
+#include <limits>
+
+#include <boost/program_options.hpp>
+
+// FLogLine is only the slot type here, nothing logs through FLOG_*: the functions a call site
+// goes through are declared as for a user of libFlashLogger, never defined or called.
+#define FLOG_COMPILED_LIBRARY
+#include "./include/FLogLine.h"
+#include "./include/FLogRecord.h"
+#include "./include/FLogCircularBuffer.h"
+#include "./include/FLogFileWritter.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+std::atomic_bool s_Stop{false};
+
+struct RingSource{
+    std::unique_ptr<FLogCircularBuffer<FLogLine>> ring;
+    pid_t pid{0};
+    bool hasHead{false};
+    std::uint8_t* head{nullptr};
+    std::size_t length{0};
+    std::size_t pos{0};
+    std::uint64_t time{0};
+};
+
+std::uint64_t RecordTime(const std::uint8_t* p_Record, std::size_t p_Length){
+
+    FLogRecordReader reader(p_Record, p_Length);
+    FLogItem item;
+    return (reader.Next(item) && item.tag == FLogTag::HEADER) ? item.now : 0;
+}
+
+void Discover(const std::string& p_Prefix, std::vector<RingSource>& p_Sources){
+
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return;
+    const std::string stem = p_Prefix + ".";
+    while (dirent* entry = readdir(dir)){
+        const std::string name(entry->d_name);
+        if (name.compare(0, stem.size(), stem) != 0) continue;
+        const std::string shmName = "/" + name;
+        bool known = false;
+        for (const auto& source : p_Sources){
+            known |= (source.ring->ShmName() == shmName);
+        }
+        if (known) continue;
+        if (auto ring = FLogCircularBuffer<FLogLine>::Attach(shmName)){
+            RingSource source;
+            source.pid = ring->OwnerPid();
+            source.ring = std::move(ring);
+            std::cout << "flashlogd: attached " << shmName << std::endl;
+            p_Sources.push_back(std::move(source));
+        }
+    }
+    closedir(dir);
+}
+
+bool IsAlive(pid_t p_Pid){
+
+    return kill(p_Pid, 0) == 0 || errno != ESRCH;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string prefix, output, format;
+    unsigned int pollMicros = 0;
+    po::options_description desc("flashlogd");
+    desc.add_options()
+            ("help", "produce help")
+            ("prefix", po::value<std::string>(&prefix)->default_value("flashlog"), "FlashLogger.shm_name of the processes to drain")
+            ("output", po::value<std::string>(&output)->default_value("./flashlogd.txt"), "merged log file")
+            ("output_format", po::value<std::string>(&format)->default_value("text"), "text, json, binary or rfc5424")
+            ("poll_us", po::value<unsigned int>(&pollMicros)->default_value(100), "sleep when every ring is empty");
+    po::variables_map vm;
+    try{
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    }catch(std::exception const& e){
+        std::cout << e.what() << std::endl << desc;
+        return 1;
+    }
+    if (vm.count("help")){
+        std::cout << desc;
+        return 0;
+    }
+
+    std::signal(SIGINT, [](int){ s_Stop.store(true); });
+    std::signal(SIGTERM, [](int){ s_Stop.store(true); });
+
+    // spans carry TSC ticks, same machine same rate.
+    FLogTickClock::Calibrate();
+    FLogFileWritter sink(output);
+    FLogRecordRenderer renderer(FLogOutputFormatFrom(format));
+    std::vector<RingSource> sources;
+    auto lastDiscovery = std::chrono::steady_clock::time_point();
+    char prefixBuffer[32];
+    // SIGINT/SIGTERM: what the rings can hold at that point is the most left to drain, a
+    // process that keeps logging does not hold the exit off.
+    bool stopping = false;
+    std::size_t drainLeft = 0;
+
+    while (true){
+        if (!stopping && s_Stop.load()){
+            stopping = true;
+            for (const auto& source : sources){
+                drainLeft += source.ring->Slots();
+            }
+        }
+        if (stopping && drainLeft == 0){
+            return 0;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (!stopping && now - lastDiscovery > 100ms){
+            Discover(prefix, sources);
+            lastDiscovery = now;
+        }
+
+        RingSource* oldest = nullptr;
+        for (auto& source : sources){
+            if (!source.hasHead){
+                source.hasHead = source.ring->ReadData(&source.head, source.length, source.pos);
+                if (source.hasHead){
+                    source.length = std::min(source.length, sizeof(FLogLine));
+                    source.time = RecordTime(source.head, source.length);
+                }
+            }
+            if (source.hasHead && (!oldest || source.time < oldest->time)){
+                oldest = &source;
+            }
+        }
+
+        if (oldest && stopping){
+            --drainLeft;
+        }
+        if (oldest && FLogIsWarmUpRecord(oldest->head, oldest->length)){
+            oldest->ring->UnlockReadPos(oldest->pos);
+            oldest->hasHead = false;
+            continue;
+        }
+        if (oldest){
+            // tag every line with the process it came from.
+            const auto length = renderer.Render(oldest->head, oldest->length);
+            const std::uint8_t* data = renderer.Data();
+            if (renderer.Format() == FLogOutputFormat::TEXT){
+                const int n = snprintf(prefixBuffer, sizeof(prefixBuffer), "[ %d ]", oldest->pid);
+                sink.WriteToFile(reinterpret_cast<std::uint8_t*>(prefixBuffer), n);
+                sink.WriteToFile(data, length);
+            }else if (renderer.Format() == FLogOutputFormat::JSON){
+                const int n = snprintf(prefixBuffer, sizeof(prefixBuffer), "{\"pid\":%d,", oldest->pid);
+                sink.WriteToFile(reinterpret_cast<std::uint8_t*>(prefixBuffer), n);
+                sink.WriteToFile(data + 1, length - 1);
+            }else{
+                sink.WriteToFile(data, length);
+            }
+            oldest->ring->UnlockReadPos(oldest->pos);
+            oldest->hasHead = false;
+            continue;
+        }
+
+        // every ring is empty: forget the ones whose process has exited.
+        for (auto it = sources.begin(); it != sources.end();){
+            if (!IsAlive(it->pid)){
+                std::cout << "flashlogd: detached " << it->ring->ShmName() << std::endl;
+                it->ring->Unlink();
+                it = sources.erase(it);
+            }else{
+                ++it;
+            }
+        }
+        if (stopping){
+            return 0;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(pollMicros));
+    }
+}
@@ -0,0 +1,304 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+// flog-query: prints the lines of a FlashLogger file matching a time range, a minimum level,
+// a call site and/or a substring, using the side index written with FlashLogger.index_every.
+//
+// Design note:
+// # - the log file is mmap'ed, the index (<file>.idx) read whole. blocks whose time range,
+//     levels or call site bloom filter cannot match are never touched.
+// # - bytes in no block (no index, records written outside the consumer loop) are scanned.
+// # - JSON lines are filtered exactly. text lines carry no level and only the sub second part
+//     of their time, there time and level are decided per block (blocks never span a second)
+//     and flog-query says so on stderr when --from, --to or --level are given.
+// # - the candidate ranges are cut in chunks scanned by a thread pool, printed in file order.
+
+#include <iostream>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <boost/program_options.hpp>
+
+#include "./include/FLogIndex.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+// first and last byte of the needle compared 16 positions at a time, memcmp on candidates.
+const char* FindSubstring(const char* p_Begin, const char* p_End, std::string_view p_Needle){
+
+    const std::size_t n = p_Needle.size();
+    if (n == 0) return p_Begin;
+    if (static_cast<std::size_t>(p_End - p_Begin) < n) return nullptr;
+    const char* p = p_Begin;
+    const char* last = p_End - n;
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(p_Needle.front());
+    const __m128i tail = _mm_set1_epi8(p_Needle.back());
+    for (; p + 16 <= last + 1; p += 16){
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + n - 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, tail)));
+        while (mask){
+            const int bit = __builtin_ctz(mask);
+            if (std::memcmp(p + bit + 1, p_Needle.data() + 1, n - 1) == 0) return p + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; p <= last; ++p){
+        if (*p == p_Needle.front() && std::memcmp(p + 1, p_Needle.data() + 1, n - 1) == 0) return p;
+    }
+    return nullptr;
+}
+
+struct Query{
+    std::uint64_t fromMicros{0};
+    std::uint64_t toMicros{std::numeric_limits<std::uint64_t>::max()};
+    std::uint8_t levels{0b111};
+    std::string function;
+    std::uint32_t line{0};             // 0: any line of function
+    std::string grep;
+
+    bool Wants(const FLogIndexBlock& p_Block) const noexcept{
+
+        if (p_Block.lastMicros < fromMicros || p_Block.firstMicros > toMicros) return false;
+        if (!(p_Block.levels & levels)) return false;
+        if (!function.empty()){
+            const std::uint64_t key = FLogIndexKeys::Function(function);
+            if (!FLogIndexKeys::Test(p_Block.sites, line ? FLogIndexKeys::Site(key, line) : key)) return false;
+        }
+        return true;
+    }
+};
+
+std::string_view Between(std::string_view p_Line, std::string_view p_Open, std::string_view p_Close){
+
+    const auto start = p_Line.find(p_Open);
+    if (start == std::string_view::npos) return {};
+    const auto end = p_Line.find(p_Close, start + p_Open.size());
+    if (end == std::string_view::npos) return {};
+    return p_Line.substr(start + p_Open.size(), end - start - p_Open.size());
+}
+
+std::uint64_t Number(std::string_view p_Text){
+
+    std::uint64_t value = 0;
+    std::from_chars(p_Text.data(), p_Text.data() + p_Text.size(), value);
+    return value;
+}
+
+bool LineMatches(const Query& p_Query, std::string_view p_Line){
+
+    if (!p_Query.grep.empty() && !FindSubstring(p_Line.data(), p_Line.data() + p_Line.size(), p_Query.grep)) return false;
+
+    const bool json = !p_Line.empty() && p_Line.front() == '{';
+    if (json){
+        const std::uint64_t ts = Number(Between(p_Line, "\"ts\":", ","));
+        if (ts < p_Query.fromMicros || ts > p_Query.toMicros) return false;
+        const auto level = Between(p_Line, "\"level\":\"", "\"");
+        const unsigned bit = level == "INFO" ? 1 : level == "WARN" ? 2 : 4;
+        if (!(bit & p_Query.levels)) return false;
+    }
+    if (p_Query.function.empty()) return true;
+
+    const auto function = json ? Between(p_Line, "\"func\":\"", "\"")
+                               : Between(p_Line.substr(std::min(p_Line.size(), p_Line.find("micro-seconds: "))), "][ ", " : ");
+    if (function != p_Query.function) return false;
+    if (!p_Query.line) return true;
+    const auto line = json ? Between(p_Line, "\"line\":", ",")
+                           : Between(p_Line, function.empty() ? "" : std::string(function) + " : ", " ]");
+    return Number(line) == p_Query.line;
+}
+
+struct Chunk{
+    std::uint64_t begin;
+    std::uint64_t end;
+    std::string out;
+};
+
+void Scan(const char* p_File, const Query& p_Query, Chunk& p_Chunk){
+
+    const char* p = p_File + p_Chunk.begin;
+    const char* end = p_File + p_Chunk.end;
+    while (p < end){
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* next = newline ? newline + 1 : end;
+        const std::string_view line(p, (newline ? newline : end) - p);
+        if (LineMatches(p_Query, line)){
+            p_Chunk.out.append(p, next - p);
+            if (!newline) p_Chunk.out.push_back('\n');
+        }
+        p = next;
+    }
+}
+
+// moves p_Offset to the start of the next line, chunks never cut a line.
+std::uint64_t LineStart(const char* p_File, std::uint64_t p_Size, std::uint64_t p_Offset){
+
+    if (p_Offset == 0 || p_Offset >= p_Size) return std::min(p_Offset, p_Size);
+    const void* newline = std::memchr(p_File + p_Offset - 1, '\n', p_Size - p_Offset + 1);
+    return newline ? static_cast<const char*>(newline) - p_File + 1 : p_Size;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string file, level, site;
+    double from = 0, to = 0;
+    unsigned int threads = 0;
+    Query query;
+    po::options_description desc("flog-query");
+    desc.add_options()
+            ("help", "produce help")
+            ("file", po::value<std::string>(&file)->required(), "FlashLogger text or json log file")
+            ("from", po::value<double>(&from)->default_value(0), "epoch seconds")
+            ("to", po::value<double>(&to)->default_value(0), "epoch seconds, 0: no end")
+            ("level", po::value<std::string>(&level)->default_value("INFO"), "lowest level: INFO, WARN or CRIT")
+            ("site", po::value<std::string>(&site)->default_value(""), "call site: function or function:line")
+            ("grep", po::value<std::string>(&query.grep)->default_value(""), "substring")
+            ("threads", po::value<unsigned int>(&threads)->default_value(0), "0: one per core")
+            ("stats", "print how much of the file was skipped to stderr");
+    po::positional_options_description positional;
+    positional.add("file", 1);
+    po::variables_map vm;
+    try{
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        if (vm.count("help")){
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }catch(std::exception const& e){
+        std::cout << e.what() << std::endl << desc;
+        return 1;
+    }
+
+    query.fromMicros = static_cast<std::uint64_t>(from * 1000000);
+    if (to > 0) query.toMicros = static_cast<std::uint64_t>(to * 1000000);
+    query.levels = level == "CRIT" ? 0b100 : level == "WARN" ? 0b110 : 0b111;
+    const auto colon = site.rfind(':');
+    if (colon != std::string::npos && colon + 1 < site.size() && std::isdigit(static_cast<unsigned char>(site[colon + 1]))){
+        query.function = site.substr(0, colon);
+        query.line = static_cast<std::uint32_t>(Number(std::string_view(site).substr(colon + 1)));
+    }else{
+        query.function = site;
+    }
+
+    const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0){
+        std::cerr << "flog-query: cannot open " << file << std::endl;
+        return 1;
+    }
+    const std::uint64_t size = st.st_size;
+    if (size == 0) return 0;
+    const char* data = static_cast<const char*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+    if (data == MAP_FAILED){
+        std::cerr << "flog-query: cannot map " << file << std::endl;
+        return 1;
+    }
+    madvise(const_cast<char*>(data), size, MADV_SEQUENTIAL);
+
+    // indexed blocks which may match, and every byte no block covers.
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+    std::uint64_t cursor = 0, skipped = 0;
+    const auto blocks = FLogReadIndex(file + ".idx");
+    if (data[0] != '{' && (query.levels != 0b111 || query.fromMicros || to > 0)){
+        std::cerr << "flog-query: " << file << " is text, --from, --to and --level select whole index blocks, "
+                  << (blocks.empty() ? "without " + file + ".idx they select nothing" : "lines of a matching block are not checked")
+                  << std::endl;
+    }
+    for (const auto& block : blocks){
+        const std::uint64_t begin = std::min(block.offset, size), end = std::min(block.end, size);
+        if (begin < cursor || end <= begin) continue;
+        if (begin > cursor) ranges.emplace_back(cursor, begin);
+        if (query.Wants(block)) ranges.emplace_back(begin, end);
+        else skipped += end - begin;
+        cursor = end;
+    }
+    if (cursor < size) ranges.emplace_back(cursor, size);
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint64_t candidate = 0;
+    for (const auto& range : ranges) candidate += range.second - range.first;
+    // no thread for less than 4MB of work.
+    const std::uint64_t chunkSize = std::max<std::uint64_t>(candidate / threads + 1, 4 << 20);
+
+    // touching ranges are scanned as one.
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> merged;
+    for (const auto& range : ranges){
+        if (!merged.empty() && merged.back().second == range.first) merged.back().second = range.second;
+        else merged.push_back(range);
+    }
+    std::vector<Chunk> chunks;
+    for (const auto& [begin, end] : merged){
+        for (std::uint64_t at = begin; at < end; ){
+            const std::uint64_t stop = (end - at > chunkSize) ? std::min(end, LineStart(data, size, at + chunkSize)) : end;
+            chunks.push_back(Chunk{at, stop, {}});
+            at = stop;
+        }
+    }
+
+    std::atomic<std::size_t> next{0};
+    auto worker = [&](){
+        for (std::size_t i; (i = next.fetch_add(1)) < chunks.size(); ){
+            Scan(data, query, chunks[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < std::min<std::size_t>(threads, chunks.size()); ++i){
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool){
+        thread.join();
+    }
+
+    for (const auto& chunk : chunks){
+        std::cout.write(chunk.out.data(), chunk.out.size());
+    }
+    if (vm.count("stats")){
+        std::cerr << "flog-query: " << size << " bytes, " << skipped << " skipped by the index, "
+                  << chunks.size() << " chunks" << std::endl;
+    }
+    munmap(const_cast<char*>(data), size);
+    close(fd);
+    return 0;
+}
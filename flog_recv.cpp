@@ -0,0 +1,157 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+// flog-recv: a minimal local receiver for the socket sink (-DSOCKET_SINK=ON), a stand-in for
+// journald / vector / fluent-bit when testing on one machine. prints what it gets to stdout.
+//
+// Design note:
+// # - "unix:<path>" and "udp:<host>:<port>" read datagrams, one record each, a newline is added.
+// # - "unix-stream:<path>" accepts any number of senders, bytes are copied as they come
+//     (records are newline framed by the sender).
+// # - one poll(2) loop, no threads. --count N exits after N records (datagrams or newlines).
+
+#include <iostream>
+#include <csignal>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace {
+
+volatile std::sig_atomic_t s_Stop{0};
+
+int Listen(const std::string& p_Endpoint, bool& p_Stream){
+
+    const auto colon = p_Endpoint.find(':');
+    const std::string scheme = p_Endpoint.substr(0, colon);
+    const std::string rest = (colon == std::string::npos) ? "" : p_Endpoint.substr(colon + 1);
+    p_Stream = (scheme == "unix-stream");
+    if (scheme == "unix" || p_Stream){
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, rest.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(rest.c_str());
+        const int fd = socket(AF_UNIX, p_Stream ? SOCK_STREAM : SOCK_DGRAM, 0);
+        if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) return -1;
+        if (p_Stream && listen(fd, 16) != 0) return -1;
+        return fd;
+    }
+    const auto port = rest.rfind(':');
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    if (scheme != "udp" || port == std::string::npos ||
+        getaddrinfo(rest.substr(0, port).c_str(), rest.substr(port + 1).c_str(), &hints, &found) != 0){
+        return -1;
+    }
+    const int fd = socket(found->ai_family, SOCK_DGRAM, 0);
+    const bool bound = fd >= 0 && bind(fd, found->ai_addr, found->ai_addrlen) == 0;
+    freeaddrinfo(found);
+    return bound ? fd : -1;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string endpoint;
+    std::uint64_t count = 0;
+    po::options_description desc("flog-recv");
+    desc.add_options()
+            ("help", "produce help")
+            ("listen", po::value<std::string>(&endpoint)->default_value("unix:/tmp/flashlog.sock"), "FlashLogger.socket_endpoint of the senders")
+            ("count", po::value<std::uint64_t>(&count)->default_value(0), "exit after N records, 0: on SIGINT");
+    po::variables_map vm;
+    try{
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    }catch(std::exception const& e){
+        std::cout << e.what() << std::endl << desc;
+        return 1;
+    }
+    if (vm.count("help")){
+        std::cout << desc;
+        return 0;
+    }
+
+    std::signal(SIGINT, [](int){ s_Stop = 1; });
+    std::signal(SIGTERM, [](int){ s_Stop = 1; });
+
+    bool stream = false;
+    const int listener = Listen(endpoint, stream);
+    if (listener < 0){
+        std::cerr << "flog-recv: cannot listen on " << endpoint << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::vector<pollfd> fds{{listener, POLLIN, 0}};
+    std::vector<char> buffer(1 << 16);
+    std::uint64_t records = 0;
+    while (!s_Stop && (!count || records < count)){
+        if (poll(fds.data(), fds.size(), 200) <= 0) continue;
+        for (std::size_t i = 0; i < fds.size(); ++i){
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (stream && fds[i].fd == listener){
+                const int client = accept(listener, nullptr, nullptr);
+                if (client >= 0) fds.push_back({client, POLLIN, 0});
+                continue;
+            }
+            const ssize_t n = recv(fds[i].fd, buffer.data(), buffer.size(), 0);
+            if (n <= 0){
+                if (stream){
+                    close(fds[i].fd);
+                    fds.erase(fds.begin() + i--);
+                }
+                continue;
+            }
+            std::cout.write(buffer.data(), n);
+            if (stream){
+                records += std::count(buffer.begin(), buffer.begin() + n, '\n');
+            }else{
+                std::cout.put('\n');
+                ++records;
+            }
+        }
+    }
+    std::cout.flush();
+    std::cerr << "flog-recv: " << records << " records" << std::endl;
+    for (const auto& fd : fds){
+        close(fd.fd);
+    }
+    if (endpoint.rfind("unix", 0) == 0){
+        unlink(endpoint.substr(endpoint.find(':') + 1).c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+// flog-replay: replays a trace recorded with FlashLogger.capture_file against this build's
+// sinks and whatever ring, format and sink settings the config gives.
+//
+// Design note:
+// # - one thread per captured thread, each line is pushed at its captured time divided by
+//     --speed (0: as fast as possible), message by message as the call site pushed it.
+// # - argument values are synthesised from the recorded shapes: strings and keys of the
+//     recorded length, counters for numbers. call sites keep their function, line and level,
+//     lines below the configured level are skipped as the call site would skip them.
+// # - statement time (first message to end) and lateness (how far behind the captured
+//     schedule a thread pushes) are reported, then Flush() time, the lines still in flight.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "./include/config.h"
+#include "./include/FLogManager.h"
+
+namespace {
+
+// const char* arguments are read after the statement returns: one static text, a string of
+// length L is its last L bytes.
+constexpr std::size_t MAX_TEXT{4096};
+const std::string s_Text = [](){
+
+    std::string text(MAX_TEXT, ' ');
+    for (std::size_t i = 0; i < MAX_TEXT; ++i) text[i] = static_cast<char>('a' + i % 26);
+    return text;
+}();
+
+const char* Text(std::uint32_t p_Length){
+
+    return s_Text.data() + MAX_TEXT - std::min<std::size_t>(p_Length, MAX_TEXT);
+}
+
+struct ReplayStats{
+    std::uint64_t lines{0};
+    std::uint64_t filtered{0};
+    std::uint64_t maxNanos{0};
+    std::uint64_t maxLateNanos{0};
+    std::uint64_t buckets[40]{};           // log2 of the statement time in ns
+    std::uint64_t lateBuckets[40]{};       // log2 of the lateness in ns
+};
+
+unsigned int Bucket(std::uint64_t p_Nanos){
+
+    return std::min<unsigned>(39, 63 - __builtin_clzll(p_Nanos | 1));
+}
+
+double Percentile(const std::uint64_t (&p_Buckets)[40], std::uint64_t p_Total, double p_Quantile){
+
+    std::uint64_t seen = 0;
+    for (unsigned int i = 0; i < 40; ++i){
+        seen += p_Buckets[i];
+        if (seen >= p_Total * p_Quantile) return double(2ULL << i);
+    }
+    return 0;
+}
+
+void Replay(const FLogCaptureReader& p_Trace, const std::vector<FLogCaptureLine>& p_Lines,
+            std::chrono::steady_clock::time_point p_Start, double p_Speed, ReplayStats& p_Stats){
+
+    FLogManager& flog = FLogManager::globalInstance();
+    std::array<FLogCaptureItem, std::tuple_size_v<decltype(ProducerMsg::data)>> items;
+    std::uint32_t counter = 0;
+    for (const auto& line : p_Lines){
+        const FLogCaptureSite* site = p_Trace.Site(line.site);
+        if (site && !flog.toLog(site->level)){
+            ++p_Stats.filtered;
+            continue;
+        }
+        if (p_Speed > 0){
+            const auto due = p_Start + std::chrono::nanoseconds(static_cast<std::uint64_t>(line.nanos / p_Speed));
+            auto now = std::chrono::steady_clock::now();
+            if (due - now > std::chrono::microseconds(200)){
+                std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+            }
+            while ((now = std::chrono::steady_clock::now()) < due){
+                std::this_thread::yield();
+            }
+            const std::uint64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count();
+            p_Stats.maxLateNanos = std::max(p_Stats.maxLateNanos, late);
+            ++p_Stats.lateBuckets[Bucket(late)];
+        }
+
+        const auto before = std::chrono::steady_clock::now();
+        std::string_view shape = line.shape;
+        for (std::uint32_t m = 0; m < line.messages; ++m){
+            const int count = FLogCaptureReader::Message(shape, items);
+            std::array<flog_item_type, std::tuple_size_v<decltype(ProducerMsg::data)>> data;
+            for (int i = 0; i < count; ++i){
+                const FLogCaptureItem& item = items[i];
+                ++counter;
+                switch (item.tag){
+                case FLogTag::STR:    data[i] = Text(item.length); break;
+                case FLogTag::KEY:    data[i] = FLogKey{Text(item.length)}; break;
+                case FLogTag::U32:    data[i] = counter; break;
+                case FLogTag::I32:    data[i] = -static_cast<int>(counter); break;
+                case FLogTag::F64:    data[i] = counter / 4.0; break;
+                case FLogTag::HEADER: data[i] = FLogHeader{FLogNow(), site ? site->function.c_str() : "flog-replay",
+                                                          site ? site->line : 0, site ? site->level : LEVEL::INFO}; break;
+                case FLogTag::SPAN:   data[i] = FLogSpan{Text(item.length), counter, FLogThreadId()}; break;
+                }
+            }
+            flog.AddProdMsg(ProducerMsg(m + 1 == line.messages, std::move(data)));
+        }
+        const std::uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count();
+        ++p_Stats.lines;
+        p_Stats.maxNanos = std::max(p_Stats.maxNanos, nanos);
+        ++p_Stats.buckets[Bucket(nanos)];
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string trace;
+    double speed = 1;
+    // every line of the trace, with its header, next to the trace.
+    flashlogger_config_data defaults = flashlogger_config_data::defaults();
+    defaults.log_file_path = "./";
+    defaults.log_file_name = "flog_replay.txt";
+    defaults.log_level = "CRIT";
+    defaults.granularity = "FULL";
+    std::unique_ptr<FLogConfig> config = std::make_unique<FLogConfig>([&](flashlogger_config_data &d, boost::program_options::options_description &desc){
+        add_flashlogger_options(d, desc, defaults);
+        desc.add_options()
+                ("trace", boost::program_options::value<std::string>(&trace)->default_value("flog_capture.bin"), "file written with FlashLogger.capture_file")
+                ("speed", boost::program_options::value<double>(&speed)->default_value(1), "1: captured pace, 10: ten times faster, 0: as fast as possible");
+    });
+    try{
+        config->parse(argc, argv);
+    }catch(std::exception const& e){
+        std::cout << e.what();
+        return 1;
+    }
+    // a replay may be captured in turn, not over the trace it reads.
+    if (config->data().capture_file == trace){
+        std::cout << "flog-replay: FlashLogger.capture_file is the trace being replayed" << std::endl;
+        return 1;
+    }
+
+    FLogCaptureReader reader;
+    if (!reader.Open(trace)){
+        std::cout << "flog-replay: " << trace << " is not a capture file" << std::endl;
+        return 1;
+    }
+    // lines grouped by captured thread, in capture order.
+    std::vector<std::vector<FLogCaptureLine>> threads;
+    std::unordered_map<std::uint32_t, std::size_t> threadIndex;
+    std::uint64_t lines = 0, span = 0;
+    FLogCaptureLine line;
+    while (reader.Next(line)){
+        auto [it, added] = threadIndex.try_emplace(line.tid, threads.size());
+        if (added) threads.emplace_back();
+        threads[it->second].push_back(line);
+        span = line.nanos;
+        ++lines;
+    }
+    const short ring = config->data().size_of_ring_buffer;
+    const std::string format = config->data().output_format;
+
+    FLogManager& flog = FLogManager::globalInstance(std::move(config));
+    flog.SetCopyrightAndStartService("");
+
+    std::vector<ReplayStats> stats(threads.size());
+    std::vector<std::thread> replayers;
+    const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    for (std::size_t t = 0; t < threads.size(); ++t){
+        replayers.emplace_back(Replay, std::cref(reader), std::cref(threads[t]), start, speed, std::ref(stats[t]));
+    }
+    for (auto& replayer : replayers){
+        replayer.join();
+    }
+    const auto pushed = std::chrono::steady_clock::now();
+    const bool flushed = flog.Flush().wait_for(std::chrono::seconds(120)) == std::future_status::ready;
+    const auto done = std::chrono::steady_clock::now();
+
+    ReplayStats total;
+    for (const auto& s : stats){
+        total.lines += s.lines;
+        total.filtered += s.filtered;
+        total.maxNanos = std::max(total.maxNanos, s.maxNanos);
+        total.maxLateNanos = std::max(total.maxLateNanos, s.maxLateNanos);
+        for (unsigned int i = 0; i < 40; ++i){
+            total.buckets[i] += s.buckets[i];
+            total.lateBuckets[i] += s.lateBuckets[i];
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(done - start).count();
+    std::printf("flog-replay: %s, %llu lines of %zu threads over %.3f s captured, speed %g\n", trace.c_str(),
+                (unsigned long long)lines, threads.size(), span / 1e9, speed);
+    std::printf("  ring %d slots, format %s\n", ring, format.c_str());
+    std::printf("  replayed %llu lines, %llu below the level, %.3f s, %.2f M lines/s\n", (unsigned long long)total.lines,
+                (unsigned long long)total.filtered, elapsed, total.lines / elapsed / 1e6);
+    std::printf("  statement p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.3f ms\n",
+                Percentile(total.buckets, total.lines, 0.5), Percentile(total.buckets, total.lines, 0.99),
+                Percentile(total.buckets, total.lines, 0.999), total.maxNanos / 1e6);
+    if (speed > 0){
+        std::printf("  behind schedule p99 %.0f ns, max %.3f ms\n",
+                    Percentile(total.lateBuckets, total.lines, 0.99), total.maxLateNanos / 1e6);
+    }
+    std::printf("  flush after the last line %.3f ms%s\n", std::chrono::duration<double, std::milli>(done - pushed).count(),
+                flushed ? "" : ", timed out");
+    return flushed ? 0 : 1;
+}
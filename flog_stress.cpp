@@ -0,0 +1,339 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+// flog-stress: soak test of the producer -> message box -> ring -> consumer -> sink path.
+//
+// Design note:
+// # - --threads producers log numbered lines (thread, sequence, every argument type and a
+//     payload derived from both) flat out or at --rate lines/s each, for --seconds.
+// # - the sink (FLOG_SINKS = FLogStressSink) checks every rendered line: a known producer, the
+//     next sequence of that producer (exactly once, in per thread order), every argument and
+//     the payload intact. it injects latency spikes and stalls so the ring fills up.
+// # - producers time every statement, stall time is the time spent in statements slower
+//     than --stall_us. after a Flush() the sink must have every committed line, exit status
+//     is 1 otherwise.
+// # - the first FIRST_STATEMENTS statements of every producer are reported apart, that is where
+//     lazy set up (thread locals, allocator caches, page faults) shows. FlashLogger.warm_up = 1
+//     runs WarmUp() at start up and PrepareThread() in every producer before its first line.
+// # - meant to be built with CMake SANITIZE=thread or SANITIZE=address as well.
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "./include/config.h"
+
+namespace {
+
+// set before the logger starts, read only afterwards.
+unsigned int s_Threads{4};
+unsigned int s_SpikeEvery{0};
+unsigned int s_SpikeMicros{0};
+unsigned int s_StallEveryMs{0};
+unsigned int s_StallMs{0};
+
+// const char* arguments are read by the logger's producer thread after the statement has
+// returned, the payloads are built once up front and live for the whole run.
+std::vector<std::string> s_Payloads;
+
+void BuildPayloads(){
+
+    for (std::size_t length = 8; length < 56; ++length){
+        for (std::size_t first = 0; first < 26; ++first){
+            std::string payload(length, ' ');
+            for (std::size_t k = 0; k < length; ++k){
+                payload[k] = static_cast<char>('a' + (first + k) % 26);
+            }
+            s_Payloads.push_back(std::move(payload));
+        }
+    }
+}
+
+const std::string& Payload(unsigned int p_Thread, std::uint32_t p_Seq){
+
+    return s_Payloads[(p_Seq % 48) * 26 + (p_Seq + p_Thread) % 26];
+}
+
+}
+
+// sink of every logger in this binary. state is per instance and touched by its consumer
+// thread only, main reads it after Flush() has synchronised with that thread.
+struct FLogStressSink{
+
+    static constexpr const char* NAME{"stress"};
+
+    template<typename CONFIG>
+    static auto ConfigArgs(const CONFIG&){ return std::make_tuple(); }
+
+    FLogStressSink()
+        :mNext(s_Threads, 0){
+
+        std::lock_guard<std::mutex> lock(Mutex());
+        Registry().push_back(this);
+    }
+
+    ~FLogStressSink(){
+
+        std::lock_guard<std::mutex> lock(Mutex());
+        Registry().erase(std::find(Registry().begin(), Registry().end(), this));
+    }
+
+    bool WriteToFile(const std::uint8_t* data, int size){
+
+        Inject();
+        mBytes += size;
+        Check(std::string_view(reinterpret_cast<const char*>(data), size));
+        return true;
+    }
+
+    bool Flush(){ return true; }
+    void Idle(){ }
+    int Fd() const noexcept{ return -1; }
+    std::uint64_t Offset() const noexcept{ return 0; }
+    int FlushForCrash() noexcept{ return STDERR_FILENO; }
+
+    static std::vector<FLogStressSink*>& Registry(){
+
+        static std::vector<FLogStressSink*> s_Sinks;
+        return s_Sinks;
+    }
+
+    static std::mutex& Mutex(){
+
+        static std::mutex s_Mutex;
+        return s_Mutex;
+    }
+
+    std::vector<std::uint64_t> mNext;      // next expected sequence per producer
+    std::uint64_t mLines{0};
+    std::uint64_t mBytes{0};
+    std::uint64_t mForeign{0};             // copyright, exit marker
+    std::uint64_t mMissing{0};
+    std::uint64_t mDuplicated{0};
+    std::uint64_t mCorrupt{0};
+    std::uint64_t mSpikes{0};
+    std::uint64_t mStalls{0};
+
+private:
+    void Inject(){
+
+        if (s_SpikeEvery && ++mSinceSpike >= s_SpikeEvery){
+            mSinceSpike = 0;
+            ++mSpikes;
+            std::this_thread::sleep_for(std::chrono::microseconds(s_SpikeMicros));
+        }
+        if (s_StallEveryMs){
+            const auto now = std::chrono::steady_clock::now();
+            if (mLastStall == std::chrono::steady_clock::time_point()) mLastStall = now;
+            if (now - mLastStall >= std::chrono::milliseconds(s_StallEveryMs)){
+                ++mStalls;
+                std::this_thread::sleep_for(std::chrono::milliseconds(s_StallMs));
+                mLastStall = std::chrono::steady_clock::now();
+            }
+        }
+    }
+
+    void Check(std::string_view p_Line){
+
+        const auto at = p_Line.find(" ] t=");
+        if (at == std::string_view::npos){
+            ++mForeign;
+            return;
+        }
+        unsigned int thread = 0;
+        unsigned long long seq = 0;
+        if (std::sscanf(p_Line.data() + at, " ] t=%u seq=%llu", &thread, &seq) != 2 || thread >= mNext.size()){
+            ++mCorrupt;
+            return;
+        }
+        // text rendering: "key=value " per field, " " and the value each followed by a space per <<.
+        char expected[256];
+        const int length = std::snprintf(expected, sizeof(expected), " ] t=%u seq=%llu u= %u  i= %d  d= %.6f  p= %s \n",
+                                         thread, seq, static_cast<unsigned>(seq * 7), -static_cast<int>(seq), seq / 4.0,
+                                         Payload(thread, static_cast<std::uint32_t>(seq)).c_str());
+        if (p_Line.substr(at) != std::string_view(expected, length)){
+            ++mCorrupt;
+            return;
+        }
+        ++mLines;
+        std::uint64_t& next = mNext[thread];
+        if (seq < next){
+            ++mDuplicated;
+            return;
+        }
+        mMissing += seq - next;
+        next = seq + 1;
+    }
+
+    unsigned int mSinceSpike{0};
+    std::chrono::steady_clock::time_point mLastStall;
+};
+
+#undef FLOG_SINKS
+#define FLOG_SINKS FLogStressSink
+#include "./include/FLogManager.h"
+
+namespace {
+
+constexpr std::size_t FIRST_STATEMENTS{4};
+
+struct ProducerStats{
+    std::uint64_t first[FIRST_STATEMENTS]{};
+    std::uint64_t committed{0};
+    std::uint64_t stalledNanos{0};
+    std::uint64_t maxNanos{0};
+    std::uint64_t buckets[40]{};           // log2 of the statement time in ns
+};
+
+void Produce(unsigned int p_Thread, std::chrono::steady_clock::time_point p_Deadline, unsigned int p_Rate,
+             std::uint64_t p_StallNanos, bool p_WarmUp, ProducerStats& p_Stats){
+
+    if (p_WarmUp){
+        FLogManager::globalInstance().PrepareThread();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t seq = 0; ; ++seq){
+        if ((seq & 255) == 0 && std::chrono::steady_clock::now() >= p_Deadline) break;
+        if (p_Rate){
+            const auto due = start + std::chrono::nanoseconds(std::uint64_t(seq) * 1000000000 / p_Rate);
+            while (std::chrono::steady_clock::now() < due){
+                std::this_thread::yield();
+            }
+        }
+        const char* payload = Payload(p_Thread, seq).c_str();
+        const auto before = std::chrono::steady_clock::now();
+        FLOG_INFO.kv("t", p_Thread).kv("seq", seq) << "u=" << seq * 7 << " i=" << -static_cast<int>(seq)
+                                                    << " d=" << seq / 4.0 << " p=" << payload;
+        const std::uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count();
+        if (seq < FIRST_STATEMENTS) p_Stats.first[seq] = nanos;
+        ++p_Stats.committed;
+        p_Stats.maxNanos = std::max(p_Stats.maxNanos, nanos);
+        if (nanos > p_StallNanos) p_Stats.stalledNanos += nanos;
+        ++p_Stats.buckets[std::min<unsigned>(39, 63 - __builtin_clzll(nanos | 1))];
+    }
+}
+
+double Percentile(const std::uint64_t (&p_Buckets)[40], std::uint64_t p_Total, double p_Quantile){
+
+    std::uint64_t seen = 0;
+    for (unsigned int i = 0; i < 40; ++i){
+        seen += p_Buckets[i];
+        if (seen >= p_Total * p_Quantile) return double(2ULL << i);
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = 10;
+    unsigned int rate = 0, stallMicros = 100;
+    // every line, with its header, through a ring large enough for bursts.
+    flashlogger_config_data defaults = flashlogger_config_data::defaults();
+    defaults.size_of_ring_buffer = 1024;
+    defaults.log_level = "CRIT";
+    defaults.granularity = "FULL";
+    std::unique_ptr<FLogConfig> config = std::make_unique<FLogConfig>([&](flashlogger_config_data &d, boost::program_options::options_description &desc){
+        add_flashlogger_options(d, desc, defaults);
+        desc.add_options()
+                ("threads", boost::program_options::value<unsigned int>(&s_Threads)->default_value(4), "producer threads")
+                ("seconds", boost::program_options::value<double>(&seconds)->default_value(10), "run time")
+                ("rate", boost::program_options::value<unsigned int>(&rate)->default_value(0), "lines per second per producer, 0: flat out")
+                ("stall_us", boost::program_options::value<unsigned int>(&stallMicros)->default_value(100), "statements slower than this count as producer stall")
+                ("spike_every", boost::program_options::value<unsigned int>(&s_SpikeEvery)->default_value(1000), "sink: a latency spike every N lines, 0: none")
+                ("spike_us", boost::program_options::value<unsigned int>(&s_SpikeMicros)->default_value(200), "sink: length of a spike")
+                ("stall_every_ms", boost::program_options::value<unsigned int>(&s_StallEveryMs)->default_value(1000), "sink: a stall every N ms, 0: none")
+                ("stall_ms", boost::program_options::value<unsigned int>(&s_StallMs)->default_value(50), "sink: length of a stall");
+    });
+    try{
+        config->parse(argc, argv);
+    }catch(std::exception const& e){
+        std::cout << e.what();
+        return 1;
+    }
+    const short ring = config->data().size_of_ring_buffer;
+    const bool warmUp = config->data().warm_up != 0;
+    BuildPayloads();
+
+    FLogManager& flog = FLogManager::globalInstance(std::move(config));
+    flog.SetCopyrightAndStartService("");
+    FLogStressSink* sink = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(FLogStressSink::Mutex());
+        sink = FLogStressSink::Registry().front();
+    }
+
+    std::vector<ProducerStats> stats(s_Threads);
+    std::vector<std::thread> producers;
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    for (unsigned int t = 0; t < s_Threads; ++t){
+        producers.emplace_back(Produce, t, deadline, rate, std::uint64_t{stallMicros} * 1000, warmUp, std::ref(stats[t]));
+    }
+    for (auto& producer : producers){
+        producer.join();
+    }
+    const bool flushed = flog.Flush().wait_for(std::chrono::seconds(120)) == std::future_status::ready;
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ProducerStats total;
+    bool ordered = true;
+    for (unsigned int t = 0; t < s_Threads; ++t){
+        for (std::size_t i = 0; i < FIRST_STATEMENTS; ++i) total.first[i] = std::max(total.first[i], stats[t].first[i]);
+        total.committed += stats[t].committed;
+        total.stalledNanos += stats[t].stalledNanos;
+        total.maxNanos = std::max(total.maxNanos, stats[t].maxNanos);
+        for (unsigned int i = 0; i < 40; ++i) total.buckets[i] += stats[t].buckets[i];
+        // every line of producer t arrived: its next expected sequence is its count.
+        ordered &= (sink->mNext[t] == stats[t].committed);
+    }
+
+    std::printf("flog-stress: %u threads, %.1f s, ring %d slots\n", s_Threads, elapsed, ring);
+    std::printf("  lines committed %llu, received %llu, missing (dropped) %llu, duplicated %llu, corrupt %llu\n",
+                (unsigned long long)total.committed, (unsigned long long)sink->mLines, (unsigned long long)sink->mMissing,
+                (unsigned long long)sink->mDuplicated, (unsigned long long)sink->mCorrupt);
+    std::printf("  throughput %.2f M lines/s, %.1f MB/s rendered\n", sink->mLines / elapsed / 1e6, sink->mBytes / elapsed / 1e6);
+    std::printf("  statement p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.3f ms, producers stalled %.3f s (> %u us)\n",
+                Percentile(total.buckets, total.committed, 0.5), Percentile(total.buckets, total.committed, 0.99),
+                Percentile(total.buckets, total.committed, 0.999), total.maxNanos / 1e6, total.stalledNanos / 1e9, stallMicros);
+    std::printf("  first statements of a producer, slowest thread: %llu, %llu, %llu, %llu ns (%s)\n",
+                (unsigned long long)total.first[0], (unsigned long long)total.first[1], (unsigned long long)total.first[2],
+                (unsigned long long)total.first[3], warmUp ? "warmed up" : "cold");
+    std::printf("  sink faults: %llu spikes of %u us, %llu stalls of %u ms\n",
+                (unsigned long long)sink->mSpikes, s_SpikeMicros, (unsigned long long)sink->mStalls, s_StallMs);
+
+    const bool ok = flushed && ordered && sink->mLines == total.committed && !sink->mMissing && !sink->mDuplicated && !sink->mCorrupt;
+    std::printf("  %s\n", ok ? "OK" : flushed ? "FAILED" : "FAILED: Flush() timed out");
+    return ok ? 0 : 1;
+}
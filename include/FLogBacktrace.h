@@ -0,0 +1,123 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_BACKTRACE_HPP
+#define FLOG_BACKTRACE_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "FLogRecord.h"
+
+#ifndef FLOG_BACKTRACE_MAX_ENTRIES
+#define FLOG_BACKTRACE_MAX_ENTRIES 64
+#endif
+
+// Design note:
+// # - lines filtered out by the level are encoded into a thread local ring instead of being
+//     dropped: no lock, no message box, no rendering, strings are copied so they stay valid.
+// # - an entry has the ring slot layout, a dump hands it to the producer as a finished record.
+// # - entries remember their logger, a dump only takes (and forgets) the ones of its logger.
+// # - the ring is trivially constructible so thread_local access needs no init guard.
+class FLogBacktrace{
+
+public:
+    static constexpr std::size_t MAX_ENTRIES = FLOG_BACKTRACE_MAX_ENTRIES;
+    static constexpr std::size_t ENTRY_SIZE = 256;   // one ring slot, sizeof(FLogLine)
+
+    static void Begin(const void* p_Owner, const FLogHeader& p_Header) noexcept{
+
+        Ring& ring = sRing;
+        Entry& entry = ring.entries[ring.next];
+        ring.next = (ring.next + 1) % MAX_ENTRIES;
+        ring.current = &entry;
+        entry.owner = p_Owner;
+        entry.length = 0;
+        Put(p_Header);
+    }
+
+    static void Put(const flog_item_type& p_Item) noexcept{
+
+        Entry* entry = sRing.current;
+        if (!entry) return;
+        FLogRecordWriter record(entry->record, ENTRY_SIZE, entry->length);
+        record.Put(p_Item);
+        entry->length = static_cast<std::uint16_t>(record.Length());
+    }
+
+    // Hands the last p_Depth entries of p_Owner, oldest first, to p_Sink(record, length)
+    // and forgets every entry of p_Owner.
+    template<typename F>
+    static std::size_t Drain(const void* p_Owner, std::size_t p_Depth, F&& p_Sink){
+
+        Ring& ring = sRing;
+        ring.current = nullptr;
+
+        std::size_t selected = 0, start = ring.next;
+        for (std::size_t i = 0; i < MAX_ENTRIES && selected < p_Depth; ++i){
+            start = (start + MAX_ENTRIES - 1) % MAX_ENTRIES;
+            selected += (ring.entries[start].owner == p_Owner && ring.entries[start].length);
+        }
+
+        std::size_t drained = 0;
+        for (std::size_t i = start; drained < selected; i = (i + 1) % MAX_ENTRIES){
+            Entry& entry = ring.entries[i];
+            if (entry.owner != p_Owner || !entry.length) continue;
+            p_Sink(entry.record, entry.length);
+            ++drained;
+        }
+        // older ones are out of the window for good.
+        for (auto& entry : ring.entries){
+            if (entry.owner == p_Owner) entry.owner = nullptr;
+        }
+        return drained;
+    }
+
+    // logging thread: the ring's pages (16KB by default) are faulted in now, not by the first
+    // lines below the level. the bytes are written back as they are.
+    static void PrepareThread() noexcept{
+
+        auto* bytes = reinterpret_cast<volatile std::uint8_t*>(&sRing);
+        for (std::size_t i = 0; i < sizeof(Ring); i += 4096){
+            bytes[i] = bytes[i];
+        }
+    }
+
+private:
+    struct Entry{
+        const void* owner;
+        std::uint16_t length;
+        alignas(8) std::uint8_t record[ENTRY_SIZE];
+    };
+
+    struct Ring{
+        std::array<Entry, MAX_ENTRIES> entries;
+        std::size_t next;
+        Entry* current;
+    };
+
+    static inline thread_local Ring sRing;
+};
+
+#endif /* FLOG_BACKTRACE_HPP */
@@ -0,0 +1,371 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_CAPTURE_HPP
+#define FLOG_CAPTURE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "FLogUtilStructs.h"
+#include "FLogRecord.h"
+#include "FLogTrace.h"
+
+// Design note:
+// # - FlashLogger.capture_file records the shape of every line of the global logger: when its
+//     first message arrived, the logging thread, the call site and, per message, the type of
+//     every argument (and the length of strings). values are not kept, a trace holds no data.
+// # - a line is encoded on the logging thread while it holds the producer lock, so the lines
+//     of all threads are already serialised. the producer thread takes the bytes under the
+//     same lock and write(2)s them after releasing it.
+// # - the file is "FLOGCAP1" then records: 'S' defines a call site once, 'L' is one line
+//     (varint time delta, thread, site, message count, per message its item shapes).
+// # - beyond MAX_PENDING bytes not yet written lines are counted as dropped, never blocked.
+// # - flog-replay reads a trace back with FLogCaptureReader.
+
+struct FLogCaptureSite{
+    std::string function;
+    std::uint32_t line{0};
+    LEVEL level{LEVEL::INFO};
+};
+
+// the shape of one argument: its record tag, the length of a string, key or span name.
+struct FLogCaptureItem{
+    FLogTag tag{FLogTag::STR};
+    std::uint32_t length{0};
+};
+
+struct FLogCaptureLine{
+    std::uint64_t nanos{0};        // since the first captured line
+    std::uint32_t tid{0};
+    std::uint32_t site{0};         // 1 based index in the sites, 0: no header (granularity BASIC)
+    std::uint32_t messages{0};
+    std::string_view shape;        // per message: item count, per item tag (+ varint length)
+};
+
+struct FLogCaptureCodec{
+
+    static constexpr char MAGIC[8] = {'F','L','O','G','C','A','P','1'};
+
+    static void PutVarint(std::string& p_Out, std::uint64_t p_Value){
+
+        while (p_Value >= 0x80){
+            p_Out.push_back(static_cast<char>(p_Value | 0x80));
+            p_Value >>= 7;
+        }
+        p_Out.push_back(static_cast<char>(p_Value));
+    }
+
+    static bool GetVarint(std::string_view& p_In, std::uint64_t& p_Value) noexcept{
+
+        p_Value = 0;
+        for (unsigned int shift = 0; shift < 64 && !p_In.empty(); shift += 7){
+            const auto byte = static_cast<std::uint8_t>(p_In.front());
+            p_In.remove_prefix(1);
+            p_Value |= std::uint64_t{byte & 0x7Fu} << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    static bool HasLength(FLogTag p_Tag) noexcept{
+
+        return p_Tag == FLogTag::STR || p_Tag == FLogTag::KEY || p_Tag == FLogTag::SPAN;
+    }
+};
+
+class FLogCaptureWriter{
+
+public:
+    static constexpr std::size_t MAX_PENDING = 64 * 1024 * 1024;
+
+    FLogCaptureWriter() = default;
+    FLogCaptureWriter(const FLogCaptureWriter&) = delete;
+    FLogCaptureWriter& operator=(const FLogCaptureWriter&) = delete;
+
+    ~FLogCaptureWriter(){
+
+        Close();
+    }
+
+    bool Open(const std::string& p_Path){
+
+        mFd = open(p_Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (mFd < 0) return false;
+        mPending.assign(FLogCaptureCodec::MAGIC, sizeof(FLogCaptureCodec::MAGIC));
+        return true;
+    }
+
+    bool IsOpen() const noexcept{ return mFd >= 0; }
+
+    std::uint64_t Lines() const noexcept{ return mLines; }
+    std::uint64_t Dropped() const noexcept{ return mDropped; }
+
+    // logging thread, under the producer lock: one message of the line being logged.
+    void Add(const ProducerMsg& p_Msg){
+
+        if (p_Msg.raw) return;     // a backtrace dump replays lines, it is not a log call
+        if (!mInLine){
+            mInLine = true;
+            mSkip = false;
+            mStart = Now();
+            mSite = 0;
+            mMessages = 0;
+            mShape.clear();
+        }
+
+        std::array<FLogCaptureItem, std::tuple_size_v<decltype(ProducerMsg::data)>> items;
+        std::size_t count = 0;
+        for (const auto& item : p_Msg.data){
+            if (Shape(item, items[count])) ++count;
+        }
+        mShape.push_back(static_cast<char>(count));
+        for (std::size_t i = 0; i < count; ++i){
+            mShape.push_back(static_cast<char>(items[i].tag));
+            if (FLogCaptureCodec::HasLength(items[i].tag)) FLogCaptureCodec::PutVarint(mShape, items[i].length);
+        }
+        ++mMessages;
+
+        if (p_Msg.isEnd){
+            mInLine = false;
+            if (mSkip) return;
+            if (mPending.size() > MAX_PENDING){
+                ++mDropped;
+                return;
+            }
+            const std::uint64_t delta = (mLines && mStart > mLast) ? mStart - mLast : 0;
+            mLast = std::max(mLast, mStart);
+            mPending.push_back('L');
+            FLogCaptureCodec::PutVarint(mPending, delta);
+            FLogCaptureCodec::PutVarint(mPending, FLogThreadId());
+            FLogCaptureCodec::PutVarint(mPending, mSite);
+            FLogCaptureCodec::PutVarint(mPending, mMessages);
+            mPending.append(mShape);
+            ++mLines;
+        }
+    }
+
+    // producer thread, under the producer lock: hands over the bytes captured so far.
+    void Take(std::string& p_Bytes){
+
+        p_Bytes.swap(mPending);
+        mPending.clear();
+    }
+
+    // producer thread, without the lock.
+    void Write(std::string& p_Bytes) noexcept{
+
+        const char* data = p_Bytes.data();
+        std::size_t left = p_Bytes.size();
+        while (mFd >= 0 && left){
+            const ssize_t n = write(mFd, data, left);
+            if (n <= 0) break;
+            data += n;
+            left -= n;
+        }
+        p_Bytes.clear();
+    }
+
+    void Close() noexcept{
+
+        if (mFd < 0) return;
+        Write(mPending);
+        close(mFd);
+        mFd = -1;
+    }
+
+private:
+    static std::uint64_t Now() noexcept{
+
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool Shape(const flog_item_type& p_Item, FLogCaptureItem& p_Shape){
+
+        return std::visit([this, &p_Shape](auto&& arg) -> bool {
+
+            using ArgT = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<ArgT, const char*>){
+                if (!arg) return false;        // unused slot
+                p_Shape = {FLogTag::STR, static_cast<std::uint32_t>(strlen(arg))};
+            }else if constexpr (std::is_same_v<ArgT, unsigned int>){
+                p_Shape = {FLogTag::U32, 0};
+            }else if constexpr (std::is_same_v<ArgT, int>){
+                p_Shape = {FLogTag::I32, 0};
+            }else if constexpr (std::is_same_v<ArgT, double>){
+                p_Shape = {FLogTag::F64, 0};
+            }else if constexpr (std::is_same_v<ArgT, FLogKey>){
+                p_Shape = {FLogTag::KEY, static_cast<std::uint32_t>(strlen(arg.name))};
+            }else if constexpr (std::is_same_v<ArgT, FLogHeader>){
+                p_Shape = {FLogTag::HEADER, 0};
+                mSkip |= (arg.line == FLOG_WARM_UP_LINE);
+                mSite = SiteId(arg);
+            }else if constexpr (std::is_same_v<ArgT, FLogSpan>){
+                p_Shape = {FLogTag::SPAN, static_cast<std::uint32_t>(strlen(arg.name))};
+            }
+            return true;
+        }, p_Item);
+    }
+
+    // call sites are keyed by function pointer and line, as the profiler does.
+    std::uint32_t SiteId(const FLogHeader& p_Header){
+
+        const std::uint64_t key = reinterpret_cast<std::uintptr_t>(p_Header.function) * 31 + p_Header.line;
+        auto [it, added] = mSites.try_emplace(key, static_cast<std::uint32_t>(mSites.size() + 1));
+        if (added){
+            const std::string_view function = p_Header.function ? p_Header.function : "";
+            mPending.push_back('S');
+            FLogCaptureCodec::PutVarint(mPending, it->second);
+            FLogCaptureCodec::PutVarint(mPending, p_Header.line);
+            mPending.push_back(static_cast<char>(p_Header.level));
+            FLogCaptureCodec::PutVarint(mPending, function.size());
+            mPending.append(function);
+        }
+        return it->second;
+    }
+
+    int mFd{-1};
+    std::string mPending;
+    std::string mShape;
+    std::unordered_map<std::uint64_t, std::uint32_t> mSites;
+    bool mInLine{false};
+    bool mSkip{false};
+    std::uint64_t mStart{0};
+    std::uint64_t mLast{0};
+    std::uint32_t mSite{0};
+    std::uint32_t mMessages{0};
+    std::uint64_t mLines{0};
+    std::uint64_t mDropped{0};
+};
+
+// Reads a whole trace into memory, lines come back in capture order.
+class FLogCaptureReader{
+
+public:
+    bool Open(const std::string& p_Path){
+
+        const int fd = open(p_Path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st{};
+        fstat(fd, &st);
+        mBytes.resize(st.st_size);
+        std::size_t read = 0;
+        while (read < mBytes.size()){
+            const ssize_t n = ::read(fd, mBytes.data() + read, mBytes.size() - read);
+            if (n <= 0) break;
+            read += n;
+        }
+        close(fd);
+        mBytes.resize(read);
+        mIn = mBytes;
+        if (mIn.substr(0, sizeof(FLogCaptureCodec::MAGIC)) != std::string_view(FLogCaptureCodec::MAGIC, sizeof(FLogCaptureCodec::MAGIC))){
+            mIn = {};
+            return false;
+        }
+        mIn.remove_prefix(sizeof(FLogCaptureCodec::MAGIC));
+        mNanos = 0;
+        return true;
+    }
+
+    // false at the end, or at a record cut short (the process died while capturing).
+    bool Next(FLogCaptureLine& p_Line){
+
+        while (!mIn.empty()){
+            const char type = mIn.front();
+            mIn.remove_prefix(1);
+            std::uint64_t a = 0, b = 0, c = 0, d = 0;
+            if (type == 'S'){
+                if (!FLogCaptureCodec::GetVarint(mIn, a) || !FLogCaptureCodec::GetVarint(mIn, b) || mIn.empty()) return false;
+                const auto level = static_cast<LEVEL>(mIn.front());
+                mIn.remove_prefix(1);
+                if (!FLogCaptureCodec::GetVarint(mIn, c) || mIn.size() < c) return false;
+                // ids are 1 based u32, see SiteId: anything else is a corrupt trace.
+                if (a == 0 || a > UINT32_MAX) return false;
+                if (mSites.size() < a) mSites.resize(a);
+                mSites[a - 1] = FLogCaptureSite{std::string(mIn.substr(0, c)), static_cast<std::uint32_t>(b), level};
+                mIn.remove_prefix(c);
+                continue;
+            }
+            if (type != 'L' || !FLogCaptureCodec::GetVarint(mIn, a) || !FLogCaptureCodec::GetVarint(mIn, b) ||
+                !FLogCaptureCodec::GetVarint(mIn, c) || !FLogCaptureCodec::GetVarint(mIn, d)) return false;
+            mNanos += a;
+            p_Line.nanos = mNanos;
+            p_Line.tid = static_cast<std::uint32_t>(b);
+            p_Line.site = static_cast<std::uint32_t>(c);
+            p_Line.messages = static_cast<std::uint32_t>(d);
+            // walk the messages once to find where the line ends.
+            std::string_view shape = mIn;
+            std::array<FLogCaptureItem, std::tuple_size_v<decltype(ProducerMsg::data)>> items;
+            for (std::uint32_t i = 0; i < p_Line.messages; ++i){
+                if (Message(shape, items) < 0) return false;
+            }
+            p_Line.shape = mIn.substr(0, mIn.size() - shape.size());
+            mIn = shape;
+            return true;
+        }
+        return false;
+    }
+
+    // 1 based, as FLogCaptureLine::site.
+    const FLogCaptureSite* Site(std::uint32_t p_Site) const noexcept{
+
+        return (p_Site && p_Site <= mSites.size()) ? &mSites[p_Site - 1] : nullptr;
+    }
+
+    // the next message of a line's shape: its item count, -1 if the shape is malformed.
+    template<std::size_t N>
+    static int Message(std::string_view& p_Shape, std::array<FLogCaptureItem, N>& p_Items) noexcept{
+
+        if (p_Shape.empty()) return -1;
+        const auto count = static_cast<std::uint8_t>(p_Shape.front());
+        p_Shape.remove_prefix(1);
+        if (count > N) return -1;
+        for (std::size_t i = 0; i < count; ++i){
+            if (p_Shape.empty()) return -1;
+            p_Items[i].tag = static_cast<FLogTag>(p_Shape.front());
+            p_Shape.remove_prefix(1);
+            std::uint64_t length = 0;
+            if (FLogCaptureCodec::HasLength(p_Items[i].tag) && !FLogCaptureCodec::GetVarint(p_Shape, length)) return -1;
+            p_Items[i].length = static_cast<std::uint32_t>(length);
+        }
+        return count;
+    }
+
+private:
+    std::string mBytes;
+    std::string_view mIn;
+    std::uint64_t mNanos{0};
+    std::vector<FLogCaptureSite> mSites;
+};
+
+#endif /* FLOG_CAPTURE_HPP */
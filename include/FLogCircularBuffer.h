@@ -27,31 +27,80 @@
 #include <iostream>
 #include <cstdlib>
 #include <atomic>
-#include <deque>
+#include <algorithm>
 #include <variant>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "FLogUtilStructs.h"
+#include "FLogRecord.h"
 
 class ProducerMsg;
 
+// "/<prefix>.<pid>" so flashlogd can find every process' ring under /dev/shm.
+inline std::string FLogShmRingName(const std::string& p_Prefix, pid_t p_Pid){
+
+    return p_Prefix.empty() ? std::string() : "/" + p_Prefix + "." + std::to_string(p_Pid);
+}
+
 template<typename T>
 class FLogCircularBuffer {
 
     static constexpr bool SLOT_LOCKED   = true;
     static constexpr bool SLOT_UNLOCKED = false;
     static constexpr int  CACHELINE_SIZE{64};
+    static constexpr std::uint64_t RING_MAGIC{0x676E6952676F4C46};   // "FLogRing"
 
-public:
-    FLogCircularBuffer(const std::size_t p_BufferSize)
-        :mBufferSize(p_BufferSize + 1),
-         mBuffer(static_cast<T*>(std::aligned_alloc(CACHELINE_SIZE, sizeof(T) * p_BufferSize))),
-         mCurrentWriteBuffer(reinterpret_cast<std::uint8_t*>(&mBuffer[mWritePos])){
+    // pack them together
+    struct SlotsState{
+        std::uint32_t data_length{0};
+        bool state_is_locked{SLOT_UNLOCKED};
+    };
 
-        std::fill_n(reinterpret_cast<std::uint8_t*>(mBuffer), sizeof(T) * p_BufferSize, 0);
-        mBufferStatesPerSlot.resize(p_BufferSize);
-        static_assert(std::atomic<SlotsState>().is_always_lock_free, "SlotsState must be aggregate class");
+    // Memory layout, same on the heap and in shared memory so another process can drain it:
+    // | RingHeader | SlotsState x mBufferSize | T x mBufferSize |
+    struct alignas(CACHELINE_SIZE) RingHeader{
+        std::atomic<std::uint64_t> magic;
+        std::uint32_t slot_size;
+        std::uint32_t buffer_size;
+        pid_t owner_pid;
+        std::atomic<std::uint64_t> read_pos;
+    };
+
+public:
+    // p_ShmName non empty ("/name"): the ring lives in a POSIX shared memory segment.
+    FLogCircularBuffer(const std::size_t p_BufferSize, const std::string& p_ShmName = std::string())
+        :FLogCircularBuffer(Allocate(p_BufferSize + 1, p_ShmName), p_BufferSize + 1, p_ShmName, true){ }
+
+    // Drain side of a shared memory ring. nullptr if the segment is missing or not a FLog ring.
+    static std::unique_ptr<FLogCircularBuffer> Attach(const std::string& p_ShmName){
+
+        const int fd = shm_open(p_ShmName.c_str(), O_RDWR, 0);
+        if (fd < 0) return nullptr;
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(RingHeader)){
+            close(fd);
+            return nullptr;
+        }
+        void* memory = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) return nullptr;
+
+        const RingHeader* header = static_cast<const RingHeader*>(memory);
+        if (header->magic.load(std::memory_order_acquire) != RING_MAGIC || header->slot_size != sizeof(T) ||
+            BytesFor(header->buffer_size) != static_cast<std::size_t>(st.st_size)){
+            munmap(memory, st.st_size);
+            return nullptr;
+        }
+        return std::unique_ptr<FLogCircularBuffer>(new FLogCircularBuffer(memory, header->buffer_size, p_ShmName, false));
     }
 
     FLogCircularBuffer(const FLogCircularBuffer&) = delete;
@@ -61,7 +110,21 @@ public:
 
     ~FLogCircularBuffer(){
 
-        std::free(mBuffer);
+        // a shared segment outlives the process on purpose, the drain side unlinks it.
+        if (mShmName.empty()){
+            std::free(mMemory);
+        }else{
+            munmap(mMemory, BytesFor(mBufferSize));
+        }
+    }
+
+    const std::string& ShmName() const noexcept{ return mShmName; }
+
+    pid_t OwnerPid() const noexcept{ return mHeader->owner_pid; }
+
+    void Unlink() noexcept{
+
+        if (!mShmName.empty()) shm_unlink(mShmName.c_str());
     }
 
     bool WriteData(const ProducerMsg& p_data){
@@ -73,8 +136,10 @@ public:
 
         auto pos = mWritePos;
 
+        // a length means committed and not consumed yet (or being read): the ring is full.
+        // a slot this producer is filling is locked with no length.
         const SlotsState& ss = std::atomic_load_explicit(&mBufferStatesPerSlot[pos], std::memory_order_acquire);
-        if (ss.state_is_locked == SLOT_LOCKED && ss.data_length != 0){
+        if (ss.data_length != 0){
             return false;
         }
 
@@ -86,29 +151,22 @@ public:
             // mCurrentWriteBuffer is always linear next so fix it in previous write itself.
         }
 
+        // typed items, rendering to text/json/binary is left to the consumer.
+        if (p_data.raw){
+            // lines are never interleaved in the message box, so no record is open here.
+            mBytesWrittenInCurrentWriteBuffer = std::min(p_data.rawLength, sizeof(T));
+            std::memcpy(mCurrentWriteBuffer, p_data.raw.get(), mBytesWrittenInCurrentWriteBuffer);
+        }
+        FLogRecordWriter record(mCurrentWriteBuffer, sizeof(T), mBytesWrittenInCurrentWriteBuffer);
         for(const auto& v: p_data.data) {
 
-            std::visit([this](auto&& arg) {
-
-                using ArgT = std::decay_t<decltype(arg)>;
-                if constexpr (std::is_arithmetic_v<ArgT>){
-
-                    std::string n = std::to_string(arg);
-                    const auto length = n.length();
-                    std::uninitialized_move_n(n.data(), length , (mCurrentWriteBuffer + mBytesWrittenInCurrentWriteBuffer));
-                    mBytesWrittenInCurrentWriteBuffer += length;
-                }else if constexpr (std::is_same_v<ArgT, const char*>){
-
-                    auto length = arg ? strlen(arg) : 0;
-                    if (length){
-                        std::uninitialized_move_n(arg, length, (mCurrentWriteBuffer + mBytesWrittenInCurrentWriteBuffer));
-                        mBytesWrittenInCurrentWriteBuffer += length;
-                    }
-                }else{
-                    static_assert(always_false_v<ArgT>, "unsupported type");
-                }
-            }, v);
+            record.Put(v);
+        }
+        // a committed record is never empty, length 0 means a free slot.
+        if (p_data.isEnd && record.Length() == 0){
+            record.Put("");
         }
+        mBytesWrittenInCurrentWriteBuffer = record.Length();
 
         if (p_data.isEnd){
 
@@ -139,7 +197,7 @@ public:
         // # - step2 if free lock it for reading
         // # - step3 in UnlockReadPos() unlock slot after writing to file.
 
-        auto pos = mReadPos;
+        auto pos = mHeader->read_pos.load(std::memory_order_relaxed);
 
         const SlotsState& ss = std::atomic_load_explicit(&mBufferStatesPerSlot[pos], std::memory_order_acquire);
         if (ss.state_is_locked == SLOT_LOCKED || ss.data_length == 0){
@@ -152,29 +210,106 @@ public:
         p_CurPos = pos;
         *p_Data = reinterpret_cast<std::uint8_t*>(std::addressof(mBuffer[pos]));
         p_Length = ss.data_length;
+        return true;
     }
 
     void UnlockReadPos(const std::size_t p_Pos)noexcept{
 
         SlotsState new_ss{0, SLOT_UNLOCKED};
         std::atomic_store_explicit(&mBufferStatesPerSlot[p_Pos], new_ss, std::memory_order_release);
-        mReadPos = getPositionAfter(p_Pos);
+        mHeader->read_pos.store(getPositionAfter(p_Pos), std::memory_order_relaxed);
     }
 
-    bool FlushBuffer(std::uint8_t** p_Data, std::size_t& p_Length){
+    // consumer: at least p_Records committed records not consumed yet. committed slots are
+    // contiguous from the read position, so one slot tells.
+    bool Holds(std::size_t p_Records) const noexcept{
 
-        static int currIndex = -1;
-        static constexpr bool END_OF_BUFFER = true;
-        if (++currIndex == mBufferSize - 1)
-            return END_OF_BUFFER;
+        if (p_Records == 0) return true;
+        if (p_Records > mBufferSize) return false;
+        const std::size_t pos = (mHeader->read_pos.load(std::memory_order_relaxed) + p_Records - 1) % mBufferSize;
+        return std::atomic_load_explicit(&mBufferStatesPerSlot[pos], std::memory_order_acquire).data_length != 0;
+    }
 
-        *p_Data = reinterpret_cast<std::uint8_t*>(std::addressof(mBuffer[currIndex]));
-        const SlotsState& ss = std::atomic_load(&mBufferStatesPerSlot[currIndex]);
-        p_Length = ss.data_length;
-        return !END_OF_BUFFER;
+    std::size_t Slots() const noexcept{ return mBufferSize; }
+
+    // Hands every committed record to p_Sink in ring order starting at the read position.
+    // Only lock free atomic loads, safe to call from a signal handler.
+    template<typename F>
+    std::size_t FlushBuffer(F&& p_Sink) noexcept{
+
+        std::size_t flushed = 0;
+        std::size_t pos = mHeader->read_pos.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < mBufferSize; ++i, pos = getPositionAfter(pos)){
+            // a slot still being written by the producer is locked with no length yet.
+            const SlotsState ss = std::atomic_load_explicit(&mBufferStatesPerSlot[pos], std::memory_order_acquire);
+            if (ss.data_length == 0)
+                continue;
+            p_Sink(reinterpret_cast<const std::uint8_t*>(std::addressof(mBuffer[pos])), ss.data_length);
+            ++flushed;
+        }
+        return flushed;
     }
 
 private:
+    FLogCircularBuffer(void* p_Memory, const std::size_t p_BufferSize, const std::string& p_ShmName, bool p_Create)
+        :mBufferSize(p_BufferSize),
+         mMemory(p_Memory),
+         mHeader(static_cast<RingHeader*>(p_Memory)),
+         mBufferStatesPerSlot(reinterpret_cast<std::atomic<SlotsState>*>(static_cast<std::uint8_t*>(p_Memory) + sizeof(RingHeader))),
+         mBuffer(reinterpret_cast<T*>(static_cast<std::uint8_t*>(p_Memory) + SlotsOffset(p_BufferSize))),
+         mShmName(p_ShmName),
+         mCurrentWriteBuffer(reinterpret_cast<std::uint8_t*>(&mBuffer[mWritePos])){
+
+        static_assert(std::atomic<SlotsState>().is_always_lock_free, "SlotsState must be aggregate class");
+        if (!p_Create) return;
+
+        // one slot per position, getPositionAfter() rolls over at mBufferSize.
+        std::fill_n(static_cast<std::uint8_t*>(p_Memory), BytesFor(p_BufferSize), 0);
+        new (mHeader) RingHeader{{0}, sizeof(T), static_cast<std::uint32_t>(p_BufferSize), getpid(), {0}};
+        for (std::size_t i = 0; i < p_BufferSize; ++i){
+            new (&mBufferStatesPerSlot[i]) std::atomic<SlotsState>(SlotsState{});
+        }
+        // published last, Attach() refuses a half initialised segment.
+        mHeader->magic.store(RING_MAGIC, std::memory_order_release);
+    }
+
+    static constexpr std::size_t SlotsOffset(std::size_t p_BufferSize) noexcept{
+
+        const std::size_t states = sizeof(RingHeader) + sizeof(std::atomic<SlotsState>) * p_BufferSize;
+        return (states + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    static constexpr std::size_t BytesFor(std::size_t p_BufferSize) noexcept{
+
+        return SlotsOffset(p_BufferSize) + sizeof(T) * p_BufferSize;
+    }
+
+    static void* Allocate(const std::size_t p_BufferSize, const std::string& p_ShmName){
+
+        const std::size_t bytes = BytesFor(p_BufferSize);
+        if (p_ShmName.empty()){
+            void* memory = std::aligned_alloc(std::max<std::size_t>(CACHELINE_SIZE, alignof(T)), bytes);
+            if (!memory) throw std::bad_alloc();
+            return memory;
+        }
+
+        const int fd = shm_open(p_ShmName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+        if (fd < 0)
+            throw std::runtime_error("shm_open failed for " + p_ShmName);
+        if (ftruncate(fd, bytes) != 0){
+            close(fd);
+            shm_unlink(p_ShmName.c_str());
+            throw std::runtime_error("ftruncate failed for " + p_ShmName);
+        }
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED){
+            shm_unlink(p_ShmName.c_str());
+            throw std::runtime_error("mmap failed for " + p_ShmName);
+        }
+        return memory;
+    }
+
     constexpr std::size_t getPositionAfter(std::size_t pos) noexcept{
 
         // Implement required policy to roll buffer. STL style one past last element is end.
@@ -182,17 +317,13 @@ private:
     }
 
     std::size_t mWritePos{0};
-    std::size_t mReadPos{0};
 
     const std::size_t mBufferSize;
+    void* const mMemory;
+    RingHeader* const mHeader;
+    std::atomic<SlotsState>* const mBufferStatesPerSlot;
     T* const mBuffer;
-
-    // pack them together
-    struct SlotsState{
-        std::uint32_t data_length{0};
-        bool state_is_locked{SLOT_UNLOCKED};
-    };
-    std::deque<std::atomic<SlotsState>> mBufferStatesPerSlot;
+    const std::string mShmName;
 
     // Helper states
     std::uint8_t* mCurrentWriteBuffer{nullptr};
@@ -0,0 +1,343 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_CODEC_HPP
+#define FLOG_CODEC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FLogRateLimit.h"
+
+// codecs are opt in at build time (CMake finds the library and defines the macro).
+#ifndef FLOG_WITH_ZLIB
+#define FLOG_WITH_ZLIB 0
+#endif
+#ifndef FLOG_WITH_LZ4
+#define FLOG_WITH_LZ4 0
+#endif
+#ifndef FLOG_WITH_ZSTD
+#define FLOG_WITH_ZSTD 0
+#endif
+
+#if FLOG_WITH_ZLIB
+#include <zlib.h>
+#endif
+#if FLOG_WITH_LZ4
+#include <lz4.h>
+#endif
+#if FLOG_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// same values as FLogProto::Codec in flog.proto.
+enum class FLogCodec : std::uint8_t{
+  NONE = 0,
+  LZ4  = 1,
+  ZSTD = 2,
+  ZLIB = 3
+};
+
+inline bool FLogCodecAvailable(FLogCodec p_Codec) noexcept{
+
+    return p_Codec == FLogCodec::NONE ||
+           (p_Codec == FLogCodec::LZ4 && FLOG_WITH_LZ4) ||
+           (p_Codec == FLogCodec::ZSTD && FLOG_WITH_ZSTD) ||
+           (p_Codec == FLogCodec::ZLIB && FLOG_WITH_ZLIB);
+}
+
+// a codec this build has no library for falls back to NONE.
+inline FLogCodec FLogCodecFrom(const std::string& p_Name) noexcept{
+
+    const FLogCodec codec = (p_Name == "lz4" ? FLogCodec::LZ4 :
+                             p_Name == "zstd" ? FLogCodec::ZSTD :
+                             p_Name == "zlib" ? FLogCodec::ZLIB : FLogCodec::NONE);
+    return FLogCodecAvailable(codec) ? codec : FLogCodec::NONE;
+}
+
+// Design note:
+// # - the dictionary is raw content (no zstd training format) so every codec can use it:
+//     the first line seen of each call site, literals and field keys as the site logs them.
+// # - a call site is recognised from the rendered line: "][ function : line ]" (text),
+//     "\"func\":...,\"line\":N" (json) or "[flog@... line=\"N\"]" (rfc5424).
+// # - complete after p_Lines lines or MAX_BYTES, whichever first. the id is a hash of the
+//     content so sender and receiver agree on it without a handshake.
+class FLogCodecDictionary{
+
+public:
+    static constexpr std::size_t MAX_BYTES{32 * 1024};   // the zlib window
+
+    explicit FLogCodecDictionary(std::size_t p_Lines = 1000)
+        :mLinesLeft(p_Lines){ }
+
+    // true once the dictionary is complete.
+    bool Feed(const std::uint8_t* p_Line, std::size_t p_Length){
+
+        if (Complete()) return true;
+        --mLinesLeft;
+        const std::string_view line(reinterpret_cast<const char*>(p_Line), p_Length);
+        const std::string_view site = SiteOf(line);
+        std::uint64_t key = 0xcbf29ce484222325ULL;
+        FLogHashBytes(key, site.data(), site.size());
+        if (mSites.insert(key).second){
+            mContent.append(line.data(), std::min(line.size(), MAX_BYTES - mContent.size()));
+        }
+        if (Complete()){
+            std::uint64_t hash = 0xcbf29ce484222325ULL;
+            FLogHashBytes(hash, mContent.data(), mContent.size());
+            // 0 means "no dictionary" on the wire.
+            mId = static_cast<std::uint32_t>(hash ^ (hash >> 32)) | 1;
+            mSites.clear();
+        }
+        return Complete();
+    }
+
+    bool Complete() const noexcept{ return !mLinesLeft || mContent.size() >= MAX_BYTES; }
+    std::uint32_t Id() const noexcept{ return mId; }
+    const std::string& Content() const noexcept{ return mContent; }
+
+private:
+    static std::string_view SiteOf(std::string_view p_Line) noexcept{
+
+        auto between = [p_Line](std::string_view p_From, std::string_view p_To) -> std::string_view{
+            const auto from = p_Line.find(p_From);
+            if (from == std::string_view::npos) return {};
+            const auto to = p_Line.find(p_To, from + p_From.size());
+            return to == std::string_view::npos ? std::string_view{} : p_Line.substr(from, to - from);
+        };
+        for (const auto& site : {between("][ ", " ]"), between("\"func\":", ",\"msg\""), between("[flog@", "]")}){
+            if (!site.empty()) return site;
+        }
+        return p_Line.substr(0, 64);
+    }
+
+    std::size_t mLinesLeft;
+    std::uint32_t mId{0};
+    std::string mContent;
+    std::unordered_set<std::uint64_t> mSites;      // hashes of the call sites seen
+};
+
+// Design note:
+// # - a block is a batch of rendered lines, compressed on its own (with the dictionary) so
+//     the receiver can decode any block it gets, in any order, knowing only the dictionary.
+// # - a block that does not shrink is sent as NONE.
+// # - level 0 is the codec's default (lz4: acceleration 1, zstd: 3, zlib: 6).
+class FLogBlockEncoder{
+
+public:
+    explicit FLogBlockEncoder(FLogCodec p_Codec, int p_Level = 0)
+        :mCodec(p_Codec), mLevel(p_Level){ }
+
+    FLogBlockEncoder(const FLogBlockEncoder&) = delete;
+    FLogBlockEncoder& operator=(const FLogBlockEncoder&) = delete;
+
+    ~FLogBlockEncoder(){
+
+#if FLOG_WITH_ZLIB
+        if (mZlibReady) deflateEnd(&mZlib);
+#endif
+#if FLOG_WITH_LZ4
+        if (mLz4) LZ4_freeStream(mLz4);
+#endif
+#if FLOG_WITH_ZSTD
+        if (mZstdDict) ZSTD_freeCDict(mZstdDict);
+        if (mZstd) ZSTD_freeCCtx(mZstd);
+#endif
+    }
+
+    // p_Content must outlive the encoder (lz4 references it).
+    void SetDictionary(const std::string* p_Content){
+
+        mDictionary = p_Content;
+#if FLOG_WITH_ZSTD
+        if (mCodec == FLogCodec::ZSTD && mDictionary){
+            if (mZstdDict) ZSTD_freeCDict(mZstdDict);
+            mZstdDict = ZSTD_createCDict(mDictionary->data(), mDictionary->size(), mLevel ? mLevel : 3);
+        }
+#endif
+    }
+
+    FLogCodec Codec() const noexcept{ return mCodec; }
+
+    // p_Out: the block as sent. returns the codec actually used.
+    FLogCodec Encode(const std::uint8_t* p_Data, std::size_t p_Length, std::string& p_Out){
+
+        // unused in a build without codec libraries.
+        [[maybe_unused]] const char* dict = mDictionary ? mDictionary->data() : nullptr;
+        [[maybe_unused]] const std::size_t dictSize = mDictionary ? mDictionary->size() : 0;
+        std::size_t size = 0;
+        switch (mCodec){
+#if FLOG_WITH_ZLIB
+        case FLogCodec::ZLIB:{
+            if (!mZlibReady){
+                mZlibReady = deflateInit(&mZlib, mLevel ? mLevel : Z_DEFAULT_COMPRESSION) == Z_OK;
+                if (!mZlibReady) break;
+            }else{
+                deflateReset(&mZlib);
+            }
+            if (dictSize){
+                deflateSetDictionary(&mZlib, reinterpret_cast<const Bytef*>(dict), dictSize);
+            }
+            p_Out.resize(deflateBound(&mZlib, p_Length));
+            mZlib.next_in = const_cast<Bytef*>(p_Data);
+            mZlib.avail_in = p_Length;
+            mZlib.next_out = reinterpret_cast<Bytef*>(p_Out.data());
+            mZlib.avail_out = p_Out.size();
+            if (deflate(&mZlib, Z_FINISH) == Z_STREAM_END){
+                size = mZlib.total_out;
+            }
+            break;
+        }
+#endif
+#if FLOG_WITH_LZ4
+        case FLogCodec::LZ4:{
+            if (!mLz4) mLz4 = LZ4_createStream();
+            if (!mLz4) break;
+            LZ4_loadDict(mLz4, dict, static_cast<int>(dictSize));
+            p_Out.resize(LZ4_compressBound(static_cast<int>(p_Length)));
+            const int n = LZ4_compress_fast_continue(mLz4, reinterpret_cast<const char*>(p_Data), p_Out.data(),
+                                                     static_cast<int>(p_Length), static_cast<int>(p_Out.size()),
+                                                     mLevel ? mLevel : 1);
+            size = n > 0 ? n : 0;
+            break;
+        }
+#endif
+#if FLOG_WITH_ZSTD
+        case FLogCodec::ZSTD:{
+            if (!mZstd) mZstd = ZSTD_createCCtx();
+            if (!mZstd) break;
+            p_Out.resize(ZSTD_compressBound(p_Length));
+            const std::size_t n = mZstdDict ? ZSTD_compress_usingCDict(mZstd, p_Out.data(), p_Out.size(), p_Data, p_Length, mZstdDict)
+                                            : ZSTD_compressCCtx(mZstd, p_Out.data(), p_Out.size(), p_Data, p_Length, mLevel ? mLevel : 3);
+            size = ZSTD_isError(n) ? 0 : n;
+            break;
+        }
+#endif
+        default:
+            break;
+        }
+
+        if (!size || size >= p_Length){
+            p_Out.assign(reinterpret_cast<const char*>(p_Data), p_Length);
+            return FLogCodec::NONE;
+        }
+        p_Out.resize(size);
+        return mCodec;
+    }
+
+private:
+    const FLogCodec mCodec;
+    const int mLevel;
+    const std::string* mDictionary{nullptr};
+#if FLOG_WITH_ZLIB
+    z_stream mZlib{};
+    bool mZlibReady{false};
+#endif
+#if FLOG_WITH_LZ4
+    LZ4_stream_t* mLz4{nullptr};
+#endif
+#if FLOG_WITH_ZSTD
+    ZSTD_CCtx* mZstd{nullptr};
+    ZSTD_CDict* mZstdDict{nullptr};
+#endif
+};
+
+// Receiving side (the log server): dictionaries by id, as they arrive with their first block.
+class FLogBlockDecoder{
+
+public:
+    void AddDictionary(std::uint32_t p_Id, std::string p_Content){
+
+        mDictionaries[p_Id] = std::move(p_Content);
+    }
+
+    bool HasDictionary(std::uint32_t p_Id) const{ return !p_Id || mDictionaries.count(p_Id); }
+
+    // false: unknown codec or dictionary, or a corrupt block.
+    bool Decode(FLogCodec p_Codec, std::uint32_t p_DictId, const void* p_Data, std::size_t p_Length,
+                std::size_t p_RawSize, std::string& p_Out) const{
+
+        if (p_Codec == FLogCodec::NONE){
+            p_Out.assign(static_cast<const char*>(p_Data), p_Length);
+            return true;
+        }
+        [[maybe_unused]] const std::string* dict = nullptr;
+        if (p_DictId){
+            const auto it = mDictionaries.find(p_DictId);
+            if (it == mDictionaries.end()) return false;
+            dict = &it->second;
+        }
+        p_Out.resize(p_RawSize);
+        switch (p_Codec){
+#if FLOG_WITH_ZLIB
+        case FLogCodec::ZLIB:{
+            z_stream zlib{};
+            if (inflateInit(&zlib) != Z_OK) return false;
+            zlib.next_in = static_cast<Bytef*>(const_cast<void*>(p_Data));
+            zlib.avail_in = p_Length;
+            zlib.next_out = reinterpret_cast<Bytef*>(p_Out.data());
+            zlib.avail_out = p_RawSize;
+            int rc = inflate(&zlib, Z_FINISH);
+            if (rc == Z_NEED_DICT && dict){
+                inflateSetDictionary(&zlib, reinterpret_cast<const Bytef*>(dict->data()), dict->size());
+                rc = inflate(&zlib, Z_FINISH);
+            }
+            const bool ok = rc == Z_STREAM_END && zlib.total_out == p_RawSize;
+            inflateEnd(&zlib);
+            return ok;
+        }
+#endif
+#if FLOG_WITH_LZ4
+        case FLogCodec::LZ4:{
+            const int n = LZ4_decompress_safe_usingDict(static_cast<const char*>(p_Data), p_Out.data(),
+                                                        static_cast<int>(p_Length), static_cast<int>(p_RawSize),
+                                                        dict ? dict->data() : nullptr, dict ? static_cast<int>(dict->size()) : 0);
+            return n == static_cast<int>(p_RawSize);
+        }
+#endif
+#if FLOG_WITH_ZSTD
+        case FLogCodec::ZSTD:{
+            ZSTD_DCtx* zstd = ZSTD_createDCtx();
+            if (!zstd) return false;
+            const std::size_t n = ZSTD_decompress_usingDict(zstd, p_Out.data(), p_RawSize, p_Data, p_Length,
+                                                            dict ? dict->data() : nullptr, dict ? dict->size() : 0);
+            ZSTD_freeDCtx(zstd);
+            return !ZSTD_isError(n) && n == p_RawSize;
+        }
+#endif
+        default:
+            return false;
+        }
+    }
+
+private:
+    std::unordered_map<std::uint32_t, std::string> mDictionaries;
+};
+
+#endif /* FLOG_CODEC_HPP */
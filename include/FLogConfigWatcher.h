@@ -0,0 +1,121 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <functional>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+// Design note:
+// # - one background thread, never on the log path. it sleeps in poll(2) on an inotify fd.
+// # - the directory is watched, not the file: editors save by rename and a file watch
+//     would be lost with the old inode.
+// # - SIGHUP only raises a flag, the reload itself runs on the watcher thread.
+class FLogConfigWatcher{
+
+public:
+    using reload_callback_t = std::function<void()>;
+
+    FLogConfigWatcher() = default;
+    FLogConfigWatcher(const FLogConfigWatcher&) = delete;
+    FLogConfigWatcher& operator=(const FLogConfigWatcher&) = delete;
+
+    ~FLogConfigWatcher(){
+
+        Stop();
+    }
+
+    void Start(const std::string& p_ConfigFile, reload_callback_t p_Reload){
+
+        const auto slash = p_ConfigFile.find_last_of('/');
+        const std::string dir = (slash == std::string::npos) ? "." : p_ConfigFile.substr(0, slash + 1);
+        mFileName = (slash == std::string::npos) ? p_ConfigFile : p_ConfigFile.substr(slash + 1);
+        mReload = std::move(p_Reload);
+
+        mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mInotify >= 0){
+            inotify_add_watch(mInotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        }
+
+        struct sigaction sa{};
+        sa.sa_handler = [](int){ sReloadRequested.store(true, std::memory_order_relaxed); };
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGHUP, &sa, nullptr);
+
+        mThread = std::thread(&FLogConfigWatcher::Run, this);
+    }
+
+    void Stop(){
+
+        mStop.store(true, std::memory_order_relaxed);
+        if (mThread.joinable()){
+            mThread.join();
+        }
+        if (mInotify >= 0){
+            close(mInotify);
+            mInotify = -1;
+        }
+    }
+
+private:
+    void Run(){
+
+        alignas(inotify_event) char events[4096];
+        while (!mStop.load(std::memory_order_relaxed)){
+            bool changed = sReloadRequested.exchange(false, std::memory_order_relaxed);
+
+            pollfd pfd{mInotify, POLLIN, 0};
+            if (mInotify >= 0 && poll(&pfd, 1, 200) > 0){
+                ssize_t n;
+                while ((n = read(mInotify, events, sizeof(events))) > 0){
+                    for (char* p = events; p < events + n; ){
+                        const auto* event = reinterpret_cast<const inotify_event*>(p);
+                        changed |= (event->len && mFileName == event->name);
+                        p += sizeof(inotify_event) + event->len;
+                    }
+                }
+            }else if (mInotify < 0){
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+
+            if (changed){
+                mReload();
+            }
+        }
+    }
+
+    static inline std::atomic_bool sReloadRequested{false};
+    std::atomic_bool mStop{false};
+    std::string mFileName;
+    reload_callback_t mReload;
+    int mInotify{-1};
+    std::thread mThread;
+};
@@ -0,0 +1,106 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// Design note:
+// # - opt-in, nothing is added to the log call. the handler runs only when the process is dying.
+// # - first faulting thread runs the flush callback, other faulting threads wait for it.
+// # - a fault inside the flush itself falls through to the previous disposition.
+// # - previous handlers are restored before re-raising so core dumps / sanitizers still work.
+class FLogCrashHandler{
+
+public:
+    using flush_callback_t = void (*)(int p_Signal);
+
+    static void Install(flush_callback_t p_Flush) noexcept{
+
+        sFlush = p_Flush;
+
+        // stack overflow faults need a stack to run on. alternate stacks are per thread,
+        // so this covers the installing thread (usually main).
+        static char s_AltStack[64 * 1024];
+        stack_t ss{};
+        ss.ss_sp = s_AltStack;
+        ss.ss_size = sizeof(s_AltStack);
+        sigaltstack(&ss, nullptr);
+
+        struct sigaction sa{};
+        sa.sa_handler = &FLogCrashHandler::OnFatalSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_ONSTACK;
+        for (std::size_t i = 0; i < N_SIGNALS; ++i){
+            sigaction(sFatalSignals[i], &sa, &sPrevious[i]);
+        }
+    }
+
+    // write(2) until done, EINTR safe.
+    static void WriteAll(int p_Fd, const std::uint8_t* p_Data, std::size_t p_Length) noexcept{
+
+        while (p_Length){
+            const ssize_t n = ::write(p_Fd, p_Data, p_Length);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            p_Data += n;
+            p_Length -= n;
+        }
+    }
+
+private:
+    static void OnFatalSignal(int p_Signal){
+
+        const long self = syscall(SYS_gettid);
+        long expected = 0;
+        if (sFlushingThread.compare_exchange_strong(expected, self)){
+            sFlush(p_Signal);
+            sFlushDone.store(true, std::memory_order_release);
+        }else if (expected != self){
+            const timespec pause{0, 1000000};
+            while (!sFlushDone.load(std::memory_order_acquire)){
+                nanosleep(&pause, nullptr);
+            }
+        }
+
+        for (std::size_t i = 0; i < N_SIGNALS; ++i){
+            if (sFatalSignals[i] == p_Signal){
+                sigaction(p_Signal, &sPrevious[i], nullptr);
+            }
+        }
+        raise(p_Signal);
+    }
+
+    static constexpr int sFatalSignals[] = {SIGSEGV, SIGBUS, SIGABRT, SIGFPE, SIGILL};
+    static constexpr std::size_t N_SIGNALS = sizeof(sFatalSignals) / sizeof(sFatalSignals[0]);
+    static inline struct sigaction sPrevious[N_SIGNALS]{};
+    static inline flush_callback_t sFlush{nullptr};
+    static inline std::atomic<long> sFlushingThread{0};
+    static inline std::atomic_bool sFlushDone{false};
+};
@@ -30,6 +30,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <cerrno>
+
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
@@ -38,9 +41,19 @@ using namespace google::protobuf::io;
 class FLogFileWritter
 {
 public:
+    static constexpr const char* NAME{"file"};
+    // FileOutputStream's default: Next() hands out the rest of one block of this size.
+    static constexpr int BLOCK_SIZE{8192};
+
+    template<typename CONFIG>
+    static auto ConfigArgs(const CONFIG& p_Data){
+
+        return std::make_tuple(p_Data.log_file_path + "/" + p_Data.log_file_name);
+    }
+
     FLogFileWritter(const std::string& p_FileName)
         : mFile(open(p_FileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777)),
-          mLogFile(new FileOutputStream(mFile)){
+          mLogFile(new FileOutputStream(mFile, BLOCK_SIZE)){
 
 #if 0   // Release
         mFile = open(p_FileName.c_str(), S_IRUSR|S_IWUSR, O_WRONLY | O_CREAT | O_TRUNC);
@@ -60,19 +73,75 @@ public:
             if (!mLogFile->Next(&out, &out_size)) {
                 return false;
             }
+            // the block starts BLOCK_SIZE before the end of what Next() handed out.
+            const std::uint8_t* block = static_cast<std::uint8_t*>(out) + out_size - BLOCK_SIZE;
             if (in_size <= out_size) {
                 memcpy(out, in, in_size);
                 mLogFile->BackUp(out_size - in_size);
+                Pending(block, static_cast<std::uint8_t*>(out) + in_size - block);
                 return true;
             }
 
             memcpy(out, in, out_size);
             in += out_size;
             in_size -= out_size;
+            Pending(block, BLOCK_SIZE);
         }
     }
 
+    // hands the buffered lines to the kernel, see FlashLogger.flush_every.
+    bool Flush() {
+
+        const bool flushed = mLogFile->Flush();
+        Pending(nullptr, 0);
+        return flushed;
+    }
+
+    // the ring ran empty. the stream buffer is pushed by Flush(), flush_every decides.
+    void Idle() {
+
+    }
+
+    // bytes written so far, buffered ones included: the file offset of the next record.
+    std::uint64_t Offset() const noexcept{
+
+        return mLogFile->ByteCount();
+    }
+
+    // file behind the sink, fdatasync'ed by FLogSyncer.
+    int Fd() const noexcept{
+
+        return mFile;
+    }
+
+    // Fatal signal path: FileOutputStream is not async-signal-safe, the block it holds is
+    // write(2)n from the span recorded by WriteToFile. the caller then write(2)s to the fd.
+    // a crash while the consumer is inside Next() can write the last block twice.
+    int FlushForCrash() noexcept{
+
+        std::size_t bytes = mPendingBytes.load(std::memory_order_acquire);
+        const std::uint8_t* block = mPendingBlock.load(std::memory_order_acquire);
+        while (block && bytes){
+            const ssize_t n = ::write(mFile, block, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            block += n;
+            bytes -= n;
+        }
+        return mFile;
+    }
+
 private:
+    void Pending(const std::uint8_t* p_Block, std::size_t p_Bytes) noexcept{
+
+        mPendingBytes.store(0, std::memory_order_release);
+        mPendingBlock.store(p_Block, std::memory_order_release);
+        mPendingBytes.store(p_Bytes, std::memory_order_release);
+    }
+
     int mFile;
     std::unique_ptr<FileOutputStream> mLogFile;
+    // what the stream buffers and the kernel has not seen yet, for FlushForCrash.
+    std::atomic<const std::uint8_t*> mPendingBlock{nullptr};
+    std::atomic<std::size_t> mPendingBytes{0};
 };
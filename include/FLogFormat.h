@@ -0,0 +1,120 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_FORMAT_HPP
+#define FLOG_FORMAT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "FLogUtilStructs.h"
+
+// Design note:
+// # - "{}" is an argument slot, "{{" and "}}" are escaped braces, anything else is literal.
+// # - the format string is split at compile time into null terminated literal segments,
+//     one more segment than slots. segments live in a static per call site.
+// # - at runtime only the arguments are captured and interleaved with the segments.
+
+constexpr bool FLogFormatIsValid(std::string_view p_Fmt) noexcept{
+
+    for (std::size_t i = 0; i < p_Fmt.size(); ++i){
+        if (p_Fmt[i] == '{' || p_Fmt[i] == '}'){
+            if (i + 1 == p_Fmt.size())
+                return false;
+            if (p_Fmt[i] == '{' && p_Fmt[i + 1] != '}' && p_Fmt[i + 1] != '{')
+                return false;
+            if (p_Fmt[i] == '}' && p_Fmt[i + 1] != '}')
+                return false;
+            ++i;
+        }
+    }
+    return true;
+}
+
+constexpr std::size_t FLogFormatSlotCount(std::string_view p_Fmt) noexcept{
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i + 1 < p_Fmt.size(); ++i){
+        if (p_Fmt[i] == '{' && p_Fmt[i + 1] == '}')
+            ++count;
+        if (p_Fmt[i] == '{' || p_Fmt[i] == '}')
+            ++i;
+    }
+    return count;
+}
+
+template<std::size_t N_CHARS, std::size_t N_SLOTS>
+struct FLogFormatSegments{
+
+    constexpr explicit FLogFormatSegments(std::string_view p_Fmt) noexcept{
+
+        std::size_t out = 0, seg = 0;
+        mBegin[0] = 0;
+        for (std::size_t i = 0; i < p_Fmt.size(); ++i){
+            const bool isBrace = (p_Fmt[i] == '{' || p_Fmt[i] == '}');
+            if (isBrace && p_Fmt[i] == '{' && p_Fmt[i + 1] == '}'){
+                mText[out++] = '\0';
+                mBegin[++seg] = out;
+            }else{
+                mText[out++] = p_Fmt[i];
+            }
+            if (isBrace) ++i;
+        }
+        mText[out] = '\0';
+    }
+
+    constexpr const char* Segment(std::size_t p_Index) const noexcept{
+
+        return mText + mBegin[p_Index];
+    }
+
+    // every slot replaces 2 chars with one '\0' so N_CHARS + 1 is always enough.
+    char mText[N_CHARS + 1]{};
+    std::size_t mBegin[N_SLOTS + 1]{};
+};
+
+// Only types which fit one of supported_loggable_type without narrowing are accepted.
+template<typename T>
+inline constexpr bool is_flog_loggable_v =
+        std::is_same_v<T, const char*> || std::is_same_v<T, char*> ||
+        std::is_same_v<T, double> || std::is_same_v<T, float> ||
+        (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= sizeof(int));
+
+template<typename T>
+constexpr flog_item_type FLogToLoggable(const T& p_Arg) noexcept{
+
+    if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>){
+        return static_cast<const char*>(p_Arg);
+    }else if constexpr (std::is_floating_point_v<T>){
+        return static_cast<double>(p_Arg);
+    }else if constexpr (std::is_signed_v<T>){
+        return static_cast<int>(p_Arg);
+    }else{
+        return static_cast<unsigned int>(p_Arg);
+    }
+}
+
+#endif /* FLOG_FORMAT_HPP */
@@ -0,0 +1,225 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FLogRecord.h"
+
+// Design note:
+// # - optional stage between the ring and the sink (FlashLogger.format_threads). the consumer
+//     copies records out of the ring into numbered batches (their slots are freed right away)
+//     and queues them for the formatter threads, each with a renderer of its own.
+// # - the consumer takes batches back strictly in number order, so the sink sees ring order
+//     whichever formatter finished first. everything but rendering (sink, index, profiler,
+//     durability, counters) stays on the consumer thread.
+// # - at most MAX_IN_FLIGHT batches exist: a busy pool stops the consumer reading the ring,
+//     which holds the producer back as a slow sink does.
+class FLogFormatterPool{
+
+public:
+    static constexpr std::size_t BATCH_RECORDS{64};
+
+    struct Batch{
+        std::size_t Count() const noexcept{ return recordEnds.size(); }
+
+        void Add(const std::uint8_t* p_Record, std::size_t p_Length){
+
+            records.insert(records.end(), p_Record, p_Record + p_Length);
+            recordEnds.push_back(records.size());
+        }
+
+        const std::uint8_t* Record(std::size_t p_Index, std::size_t& p_Length) const noexcept{
+
+            const std::size_t begin = p_Index ? recordEnds[p_Index - 1] : 0;
+            p_Length = recordEnds[p_Index] - begin;
+            return records.data() + begin;
+        }
+
+        const std::uint8_t* Rendered(std::size_t p_Index, std::size_t& p_Length) const noexcept{
+
+            const std::size_t begin = p_Index ? renderedEnds[p_Index - 1] : 0;
+            p_Length = renderedEnds[p_Index] - begin;
+            return reinterpret_cast<const std::uint8_t*>(rendered.data()) + begin;
+        }
+
+        void Clear() noexcept{
+
+            records.clear();
+            recordEnds.clear();
+            rendered.clear();
+            renderedEnds.clear();
+            written = 0;
+            done.store(false, std::memory_order_relaxed);
+        }
+
+        std::vector<std::uint8_t> records;
+        std::vector<std::size_t> recordEnds;
+        std::string rendered;
+        std::vector<std::size_t> renderedEnds;
+        std::size_t written{0};            // records the consumer has handed to the sink
+        std::atomic_bool done{false};      // rendered, set by the formatter thread
+    };
+
+    FLogFormatterPool(std::size_t p_Threads, FLogOutputFormat p_Format)
+        :mBatches(2 * p_Threads + 2), mInFlight(mBatches.size()){
+
+        for (auto& batch : mBatches){
+            batch = std::make_unique<Batch>();
+            batch->records.reserve(BATCH_RECORDS * 256);
+            batch->rendered.reserve(BATCH_RECORDS * 256);
+            mFree.push_back(batch.get());
+        }
+        for (std::size_t i = 0; i < p_Threads; ++i){
+            mThreads.emplace_back(&FLogFormatterPool::Run, this, p_Format);
+        }
+    }
+
+    FLogFormatterPool(const FLogFormatterPool&) = delete;
+    FLogFormatterPool& operator=(const FLogFormatterPool&) = delete;
+
+    ~FLogFormatterPool(){
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWakeUp.notify_all();
+        for (auto& thread : mThreads){
+            thread.join();
+        }
+    }
+
+    // consumer: an empty batch to fill, nullptr while every batch is out.
+    Batch* Acquire() noexcept{
+
+        if (mFree.empty()) return nullptr;
+        Batch* batch = mFree.back();
+        mFree.pop_back();
+        return batch;
+    }
+
+    // consumer: p_Batch goes to the formatters, an empty one straight back to the free list.
+    void Submit(Batch* p_Batch){
+
+        if (!p_Batch->Count()){
+            mFree.push_back(p_Batch);
+            return;
+        }
+        const std::size_t tail = mInFlightTail.load(std::memory_order_relaxed);
+        mInFlight[tail % mInFlight.size()] = p_Batch;
+        mInFlightTail.store(tail + 1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(p_Batch);
+        }
+        mWakeUp.notify_one();
+    }
+
+    // consumer: the oldest batch once it is rendered, nullptr if it is not yet (or none is out).
+    Batch* Front() const noexcept{
+
+        if (Empty()) return nullptr;
+        Batch* batch = mInFlight[mInFlightHead.load(std::memory_order_relaxed) % mInFlight.size()];
+        return batch->done.load(std::memory_order_acquire) ? batch : nullptr;
+    }
+
+    // consumer: the front batch is written.
+    void PopFront(){
+
+        const std::size_t head = mInFlightHead.load(std::memory_order_relaxed);
+        Batch* batch = mInFlight[head % mInFlight.size()];
+        mInFlightHead.store(head + 1, std::memory_order_release);
+        batch->Clear();
+        mFree.push_back(batch);
+    }
+
+    bool Empty() const noexcept{
+
+        return mInFlightHead.load(std::memory_order_relaxed) == mInFlightTail.load(std::memory_order_relaxed);
+    }
+
+    // crash handler: raw records out of the ring and not written yet, oldest first.
+    // a submitted batch is not changed until it is popped, the handler reads the indexes only.
+    template<typename F>
+    std::size_t ForEachPending(F&& p_Sink) const noexcept{
+
+        std::size_t count = 0, length = 0;
+        const std::size_t tail = mInFlightTail.load(std::memory_order_acquire);
+        for (std::size_t next = mInFlightHead.load(std::memory_order_acquire); next < tail; ++next){
+            const Batch* batch = mInFlight[next % mInFlight.size()];
+            for (std::size_t i = batch->written; i < batch->Count(); ++i, ++count){
+                const std::uint8_t* record = batch->Record(i, length);
+                p_Sink(record, length);
+            }
+        }
+        return count;
+    }
+
+private:
+    void Run(FLogOutputFormat p_Format){
+
+        FLogRecordRenderer renderer(p_Format);
+        while (true){
+            Batch* batch = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWakeUp.wait(lock, [this](){ return !mQueue.empty() || mStop; });
+                if (mQueue.empty()) return;
+                batch = mQueue.front();
+                mQueue.pop_front();
+            }
+            std::size_t length = 0;
+            for (std::size_t i = 0; i < batch->Count(); ++i){
+                const std::uint8_t* record = batch->Record(i, length);
+                batch->rendered.append(reinterpret_cast<const char*>(renderer.Data()), renderer.Render(record, length));
+                batch->renderedEnds.push_back(batch->rendered.size());
+            }
+            batch->done.store(true, std::memory_order_release);
+        }
+    }
+
+    std::vector<std::unique_ptr<Batch>> mBatches;
+    // consumer thread only.
+    std::vector<Batch*> mFree;
+    // submitted batches in number order, a ring as large as mBatches: never reallocated.
+    std::vector<Batch*> mInFlight;
+    std::atomic<std::size_t> mInFlightHead{0};
+    std::atomic<std::size_t> mInFlightTail{0};
+    // shared with the formatters.
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::deque<Batch*> mQueue;
+    bool mStop{false};
+    std::vector<std::thread> mThreads;
+};
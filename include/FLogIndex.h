@@ -0,0 +1,179 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_INDEX_HPP
+#define FLOG_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FLogUtilStructs.h"
+
+// Design note:
+// # - "<log file>.idx" is a sparse side index of the log file written by the consumer: one
+//     fixed size block entry every FlashLogger.index_every records, and at every new second.
+// # - a block knows its byte range, time range, the levels in it and a 256 bit bloom filter
+//     of its call sites (function, and function + line), so a query skips blocks which cannot
+//     match without reading them.
+// # - records written outside the consumer loop (exit summaries, reports) are in no block,
+//     readers scan such gaps.
+// # - entries are appended with write(2) once per block; the log bytes they point to may
+//     still be in the sink's buffer, readers clamp to the file size.
+
+struct FLogIndexBlock{
+    std::uint64_t offset;          // first byte of the first record
+    std::uint64_t end;             // one past the last byte of the last record
+    std::uint64_t firstMicros;     // lowest header time
+    std::uint64_t lastMicros;      // highest header time
+    std::uint32_t records;
+    std::uint8_t levels;           // 1 << LEVEL
+    std::uint8_t reserved[3];
+    std::uint64_t sites[4];
+};
+static_assert(sizeof(FLogIndexBlock) == 72, "index entries are read back as they are written");
+
+struct FLogIndexHeader{
+    char magic[8];                 // "FLOGIDX1"
+    std::uint32_t blockRecords;
+    std::uint32_t entrySize;
+};
+
+struct FLogIndexKeys{
+
+    static std::uint64_t Function(std::string_view p_Function) noexcept{
+
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c : p_Function) hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+        return hash;
+    }
+
+    static std::uint64_t Site(std::uint64_t p_Function, std::uint32_t p_Line) noexcept{
+
+        return p_Function ^ ((p_Line + 1) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    static void Set(std::uint64_t (&p_Bloom)[4], std::uint64_t p_Key) noexcept{
+
+        const std::uint64_t bit = (p_Key * 0x9E3779B97F4A7C15ULL) >> 56;
+        p_Bloom[bit >> 6] |= 1ULL << (bit & 63);
+    }
+
+    static bool Test(const std::uint64_t (&p_Bloom)[4], std::uint64_t p_Key) noexcept{
+
+        const std::uint64_t bit = (p_Key * 0x9E3779B97F4A7C15ULL) >> 56;
+        return p_Bloom[bit >> 6] & (1ULL << (bit & 63));
+    }
+};
+
+class FLogIndexWriter{
+
+public:
+    FLogIndexWriter() = default;
+    FLogIndexWriter(const FLogIndexWriter&) = delete;
+    FLogIndexWriter& operator=(const FLogIndexWriter&) = delete;
+
+    ~FLogIndexWriter(){
+
+        Close();
+    }
+
+    bool Open(const std::string& p_Path, std::uint32_t p_BlockRecords){
+
+        mFd = open(p_Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (mFd < 0) return false;
+        mBlockRecords = p_BlockRecords ? p_BlockRecords : 1;
+        FLogIndexHeader header{{'F','L','O','G','I','D','X','1'}, mBlockRecords, sizeof(FLogIndexBlock)};
+        return write(mFd, &header, sizeof(header)) == sizeof(header);
+    }
+
+    bool IsOpen() const noexcept{ return mFd >= 0; }
+
+    // consumer thread, after a record went to the sink at [p_Offset, p_End).
+    void Add(std::uint64_t p_Micros, LEVEL p_Level, std::string_view p_Function, std::uint32_t p_Line,
+             std::uint64_t p_Offset, std::uint64_t p_End) noexcept{
+
+        if (mBlock.records && (mBlock.records >= mBlockRecords || p_Micros / 1000000 != mBlock.firstMicros / 1000000)){
+            Emit();
+        }
+        if (!mBlock.records){
+            mBlock = FLogIndexBlock{};
+            mBlock.offset = p_Offset;
+            mBlock.firstMicros = mBlock.lastMicros = p_Micros;
+        }
+        mBlock.end = p_End;
+        mBlock.firstMicros = std::min(mBlock.firstMicros, p_Micros);
+        mBlock.lastMicros = std::max(mBlock.lastMicros, p_Micros);
+        mBlock.levels |= 1u << static_cast<unsigned>(p_Level);
+        const std::uint64_t function = FLogIndexKeys::Function(p_Function);
+        FLogIndexKeys::Set(mBlock.sites, function);
+        FLogIndexKeys::Set(mBlock.sites, FLogIndexKeys::Site(function, p_Line));
+        ++mBlock.records;
+    }
+
+    void Close() noexcept{
+
+        if (mFd < 0) return;
+        Emit();
+        close(mFd);
+        mFd = -1;
+    }
+
+private:
+    void Emit() noexcept{
+
+        if (!mBlock.records) return;
+        [[maybe_unused]] const auto written = write(mFd, &mBlock, sizeof(mBlock));
+        mBlock.records = 0;
+    }
+
+    int mFd{-1};
+    std::uint32_t mBlockRecords{0};
+    FLogIndexBlock mBlock{};
+};
+
+// whole index in memory: 72 bytes per block.
+inline std::vector<FLogIndexBlock> FLogReadIndex(const std::string& p_Path){
+
+    std::vector<FLogIndexBlock> blocks;
+    const int fd = open(p_Path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return blocks;
+    FLogIndexHeader header{};
+    if (read(fd, &header, sizeof(header)) == sizeof(header) && std::memcmp(header.magic, "FLOGIDX1", 8) == 0 &&
+        header.entrySize == sizeof(FLogIndexBlock)){
+        FLogIndexBlock block;
+        while (read(fd, &block, sizeof(block)) == sizeof(block)){
+            blocks.push_back(block);
+        }
+    }
+    close(fd);
+    return blocks;
+}
+
+#endif /* FLOG_INDEX_HPP */
@@ -26,6 +26,7 @@
 #define FLOG_LINE_HPP
 
 #include <iostream>
+#include <algorithm>
 #include <type_traits>
 #include <variant>
 #include <vector>
@@ -34,8 +35,13 @@
 #include <string.h>
 
 #include "FLogUtilStructs.h"
+#include "FLogFormat.h"
+#include "FLogRateLimit.h"
+#include "FLogBacktrace.h"
 
-void AddProdMsgExternal(ProducerMsg&&);
+class FLogManager;
+FLOG_EXTERNAL void AddProdMsgExternal(FLogManager*, ProducerMsg&&);
+FLOG_EXTERNAL bool FLogIsFullExternal(const FLogManager*) noexcept;
 
 static constexpr int MAX_DATE_TIME_STRING_LENGTH =  20;
 static constexpr int MAX_FUNCTION_NAME_LENGTH    =  70;
@@ -46,25 +52,82 @@ static constexpr int MAX_DELIMITER_LENGTH        =   1;
 //                                                  256 (multiples of 64 so 4 cache lines)
 //                                                 ----
 
+// a FLOG_*_FMT_DEDUP call site: its limiter and where a late "repeated" report goes. listed
+// by its first swallowed line, the consumer of the owner reports what a quiet site kept.
+struct FLogDedupSite{
+
+    void List(FLogManager* p_Owner, const char* p_Function, std::uint32_t p_Line, LEVEL p_Level) noexcept{
+
+        if (listed.load(std::memory_order_relaxed) || listed.exchange(true, std::memory_order_relaxed)) return;
+        owner = p_Owner;
+        function = p_Function;
+        line = p_Line;
+        level = p_Level;
+        next = sSites.load(std::memory_order_relaxed);
+        while (!sSites.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    template<typename F>
+    static void ForEach(F&& p_Visit){
+
+        for (FLogDedupSite* site = sSites.load(std::memory_order_acquire); site; site = site->next){
+            p_Visit(*site);
+        }
+    }
+
+    static bool Any() noexcept{ return sSites.load(std::memory_order_relaxed) != nullptr; }
+
+    FLogDedup dedup;
+    FLogManager* owner{nullptr};
+    const char* function{nullptr};
+    std::uint32_t line{0};
+    LEVEL level{LEVEL::INFO};
+    std::atomic_bool listed{false};
+    FLogDedupSite* next{nullptr};
+
+    static inline std::atomic<FLogDedupSite*> sSites{nullptr};
+};
+// a function local static, still read by the logger's exit after static destruction began.
+static_assert(std::is_trivially_destructible_v<FLogDedupSite>, "a dedup site is never destroyed");
+
 static constexpr std::size_t MAX_LOG_LINE_SIZE{MAX_DATE_TIME_STRING_LENGTH + MAX_FUNCTION_NAME_LENGTH + MAX_LINE_NAME_LENGTH + MAX_USER_DATA_LENGTH + MAX_DELIMITER_LENGTH};
 class alignas(MAX_LOG_LINE_SIZE + 1) FLogLine {
 
 public:
     FLogLine() = default;
+    // the line of one logger (global or named category), pieces go to its message box.
+    explicit FLogLine(FLogManager* p_Owner):mOwner(p_Owner){}
 
-    void InitData(uint64_t p_Now, char const* p_Function, uint32_t p_Line){
+    FLOG_NOINLINE void InitData(uint64_t p_Now, char const* p_Function, uint32_t p_Line, LEVEL p_Level) const{
 
-        AddProdMsgExternal(ProducerMsg(false, {"[ ", Gettime(p_Now), " ]",
-                                               "[ ", p_Function, " : ", p_Line, " ]"}));
+        AddProdMsgExternal(mOwner, ProducerMsg(false, {FLogHeader{p_Now, p_Function, p_Line, p_Level}}));
     }
 
-    const FLogLine& operator=(const FLogLine& other){ mIgnore = false; return *this; }
+    // a line assigned from the Null Object stays ignored. out of line, it is on every call site.
+    FLOG_NOINLINE const FLogLine& operator=(const FLogLine& other){
 
-    ~FLogLine(){ if (!mIgnore) AddProdMsgExternal(ProducerMsg(true, {" \n"})); }
+        mIgnore = !other.IsEnabled();
+        mCapture = other.IsCapturing();
+        mOwner = other.mOwner;
+        return *this;
+    }
+
+    virtual bool IsEnabled() const noexcept{ return true; }
+
+    // filtered out by the level but kept in the thread's backtrace ring (FlashLogger.backtrace).
+    virtual bool IsCapturing() const noexcept{ return false; }
+
+    ~FLogLine(){ if (!mIgnore) PushEnd(); }
+
+    // out of line: every call site ends a line, the message is built once here.
+    FLOG_NOINLINE void PushEnd() const{
+
+        AddProdMsgExternal(mOwner, ProducerMsg(true, {}));
+    }
 
     virtual const FLogLine& operator<<(const supported_loggable_type&& p_Arg) const{
 
-        std::visit([](auto&& arg) {
+        std::visit([this](auto&& arg) {
 
             using argT = std::decay_t<decltype(arg)>;
             if constexpr (std::is_same_v<argT, const char*> ||
@@ -72,7 +135,7 @@ public:
                           std::is_same_v<argT, int>         ||
                           std::is_same_v<argT, double>){
 
-                        AddProdMsgExternal(ProducerMsg(false, {" ", arg}));
+                        AddProdMsgExternal(mOwner, ProducerMsg(false, {" ", arg}));
             }else{
 
                 static_assert(always_false_v<argT>, "implement \"<<\" operator for un-supported type");
@@ -82,38 +145,115 @@ public:
         return *this;
     }
 
-private:
-    char* Gettime(uint64_t p_Now){
-
-        // Need a fix here for corrupted date time. need a dynamic buffer.
-        static char mbstr_CB[5][100];
-        static std::int8_t index = -1;
-        index = (++index % 5);
-        char* mbstr = *(mbstr_CB + index);
-        std::fill_n(mbstr, 100, 0);
-
-        auto duration = std::chrono::microseconds(p_Now);
-        std::chrono::system_clock::time_point time_point(duration);
-        std::time_t time_t = std::chrono::system_clock::to_time_t(time_point);
-        if (int len; len = std::strftime(mbstr, 100, "%c", std::localtime(&time_t))){
-
-            static char microseconds[20];
-            sprintf(microseconds, " micro-seconds: %03lu", duration.count());
-            strncat(mbstr, microseconds, 19);
-            return mbstr;
+    // structured field: FLOG_INFO.kv("order_id", id).kv("px", px) << "filled";
+    template<typename T>
+    const FLogLine& kv(const char* p_Key, const T& p_Value) const{
+
+        static_assert(is_flog_loggable_v<std::decay_t<T>>, "log field value type is not loggable without narrowing");
+        if (IsEnabled()){
+            AddProdMsgExternal(mOwner, ProducerMsg(false, {FLogKey{p_Key}, FLogToLoggable<std::decay_t<T>>(p_Value)}));
+        }else if (IsCapturing()){
+            FLogBacktrace::Put(FLogKey{p_Key});
+            FLogBacktrace::Put(FLogToLoggable<std::decay_t<T>>(p_Value));
         }
-        return "Empty";
+        return *this;
     }
 
+    // use through FLOG_*_FMT so p_Fmt is a constexpr lambda unique to the call site.
+    template<typename FmtT, typename... Args>
+    const FLogLine& Format(FmtT p_Fmt, const Args&... p_Args) const{
+
+        constexpr std::string_view fmt = p_Fmt();
+        constexpr std::size_t slots = FLogFormatSlotCount(fmt);
+        static_assert(FLogFormatIsValid(fmt), "unbalanced '{' or '}' in log format string, escape as \"{{\" / \"}}\"");
+        static_assert(slots == sizeof...(Args), "log format string \"{}\" count does not match the number of arguments");
+        static_assert((is_flog_loggable_v<std::decay_t<Args>> && ...), "log format argument type is not loggable without narrowing");
+
+        if (mIgnore && !mCapture) return *this;
+
+        static constexpr FLogFormatSegments<fmt.size(), slots> s_Segments{fmt};
+
+        // seg0 arg0 seg1 arg1 ... segN
+        const std::array<flog_item_type, slots> args{FLogToLoggable<std::decay_t<Args>>(p_Args)...};
+        std::array<flog_item_type, (2 * slots) + 1> items;
+        items[0] = s_Segments.Segment(0);
+        for (std::size_t i = 0; i < slots; ++i){
+            items[2 * i + 1] = args[i];
+            items[2 * i + 2] = s_Segments.Segment(i + 1);
+        }
+
+        if (mIgnore){
+            for (const auto& item : items){
+                FLogBacktrace::Put(item);
+            }
+            return *this;
+        }
+
+        constexpr std::size_t chunk = std::tuple_size_v<decltype(ProducerMsg::data)>;
+        for (std::size_t i = 0; i < items.size(); i += chunk){
+            std::array<flog_item_type, chunk> data;
+            std::copy(items.begin() + i, items.begin() + std::min(i + chunk, items.size()), data.begin());
+            AddProdMsgExternal(mOwner, ProducerMsg(false, std::move(data)));
+        }
+        return *this;
+    }
+
+    // use through FLOG_*_FMT_DEDUP: identical consecutive lines of the site are swallowed and
+    // reported as one "previous line repeated K times" before the next different line, or by
+    // the consumer once the site is quiet. p_Enabled: FlashLogger.rate_limit.
+    template<typename FmtT, typename... Args>
+    const FLogLine& FormatDedup(LEVEL p_Level, const char* p_Function, std::uint32_t p_Line, bool p_Enabled,
+                                FmtT p_Fmt, const Args&... p_Args) const{
+
+        if (mIgnore) return *this;
+
+        static FLogDedupSite s_Site;
+        std::uint32_t repeated = 0;
+        if (p_Enabled && !s_Site.dedup.Pass(FLogHashArgs(p_Args...), repeated)){
+            s_Site.List(mOwner, p_Function, p_Line, p_Level);
+            // nothing was pushed yet, so the line can still vanish.
+            mIgnore = true;
+            return *this;
+        }
+
+        const bool withHeader = FLogIsFullExternal(mOwner);
+        if (repeated){
+            if (withHeader) InitData(FLogNow(), p_Function, p_Line, p_Level);
+            AddProdMsgExternal(mOwner, ProducerMsg(true, {"previous line repeated ", repeated, " times"}));
+        }
+        if (withHeader) InitData(FLogNow(), p_Function, p_Line, p_Level);
+        return Format(p_Fmt, p_Args...);
+    }
+
+private:
     mutable bool mIgnore{true};
+    bool mCapture{false};
+    FLogManager* mOwner{nullptr};
 };
 
 // Null Object Design pattern
 struct FLogLineDummy final : public FLogLine{
 
+    bool IsEnabled() const noexcept override{ return false; }
+
+    // disabled and rate limited lines end here, keep it free.
     const FLogLineDummy& operator<<(const supported_loggable_type&& p_Arg) const override{
 
-        std::cout << "ignored: " << std::endl;
+        return *this;
+    }
+};
+
+// disabled line of a logger with a backtrace: arguments are encoded, nothing is pushed.
+struct FLogLineBacktrace final : public FLogLine{
+
+    bool IsEnabled() const noexcept override{ return false; }
+
+    bool IsCapturing() const noexcept override{ return true; }
+
+    const FLogLineBacktrace& operator<<(const supported_loggable_type&& p_Arg) const override{
+
+        FLogBacktrace::Put(" ");
+        std::visit([](auto&& arg){ FLogBacktrace::Put(arg); }, p_Arg);
         return *this;
     }
 };
@@ -32,41 +32,80 @@
 #include <mutex>
 #include <future>
 #include <condition_variable>
+#include <sstream>
+#include <string_view>
+#include <utility>
 
 #include "config.h"
 #include "FLogUtilStructs.h"
 #include "FLogLine.h"
+#include "FLogRecord.h"
+#include "FLogCrashHandler.h"
+#include "FLogConfigWatcher.h"
+#include "FLogSyncer.h"
+#include "FLogTrace.h"
+#include "FLogScopeTimer.h"
+#include "FLogTraceFile.h"
+#include "FLogSiteProfiler.h"
+#include "FLogIndex.h"
 #include "FLogCircularBuffer.h"
 #include "FLogWritter.h"
-#if(USE_MICROSERVICE)
-#include "FLogMicroServiceWritter.h"
-#else
-#include "FLogFileWritter.h"
-#endif
+#include "FLogFormatterPool.h"
+#include "FLogCapture.h"
+#include "FLogSpill.h"
 
+// Design note:
+// # - globalInstance() is the unnamed default logger, FLOG_INFO/WARN/CRIT go there.
+// # - every "FlashLogger.category" line of the config creates one more FLogManager with its own
+//     level, ring, sink and producer/consumer threads, started with the global one.
+// # - Category(name) is a string lookup, done once per call site by FLOG_CATEGORY and cached
+//     in a function local static. an unknown name resolves to the global logger.
+// # - level, granularity, rate_limit and flush_every are relaxed atomics so Reload() can change
+//     them while lines are logged. ring, sink and format are fixed at start up.
+// # - background_threads = 0: no producer/consumer thread, the host drives both with Poll()
+//     from its own loop. the same steps (MoveBoxToRing, ConsumeOne) run either way.
+// # - lines are counted twice: when their end is pushed (mPushedLines) and when the consumer
+//     has written them (mWrittenLines). Flush() waits for the second to catch up with the first.
 class FLogManager{
 
     static constexpr std::size_t MAX_SLOT_LEN = sizeof(FLogLine);
+    static_assert(FLogBacktrace::ENTRY_SIZE == MAX_SLOT_LEN, "a backtrace entry is dumped as one ring slot");
 
 public:
     FLogManager(const FLogManager &rhs) = delete;
     FLogManager& operator=(const FLogManager &rhs) = delete;
-    static FLogManager& globalInstance(std::unique_ptr<FLogConfig> p_Config = nullptr){
+    // the first call passes the config. call sites inline one load, construction is out of line.
+    static FLogManager& globalInstance(){
+
+        FLogManager* self = sGlobal.load(std::memory_order_acquire);
+        return self ? *self : globalInstance(nullptr);
+    }
+
+    FLOG_COLD static FLogManager& globalInstance(std::unique_ptr<FLogConfig> p_Config){
 
         static FLogManager s_Self(std::move(p_Config));
+        sGlobal.store(&s_Self, std::memory_order_release);
         return s_Self;
     }
 
     ~FLogManager() noexcept{
 
         try{
-            mHostAppExited.store(true, std::memory_order_relaxed);
+            mConfigWatcher.Stop();
+            // last line first: once the producer sees the flag the box holds everything.
             AddProdMsg(ProducerMsg(true, {"\n\n******FLog completed*******"}));
+            if (mThreadless){
+                DrainAll();
+                return;
+            }
+            mHostAppExited.store(true, std::memory_order_release);
             std::cout << "Producer Exit: " << std::boolalpha << mTasksFutures[0].get() << std::endl;
             mConsExit.store(true, std::memory_order_relaxed);
-            std::cout << "Consumer Exit: " << std::boolalpha << mTasksFutures[1].get() << std::endl;
+            if (mTasksFutures.size() > 1){
+                std::cout << "Consumer Exit: " << std::boolalpha << mTasksFutures[1].get() << std::endl;
+            }
 
-#if(!USE_MICROSERVICE)
+#if(!USE_MICROSERVICE && !USE_SOCKET_SINK)
             std::string tmp;
             std::stringstream ss(tmp);
             ss << "subl -n " << /*mConfig->data().log_file_path*/"." << "/" << /*mConfig->data().log_file_name*/"flashlog.txt";
@@ -79,33 +118,272 @@ public:
     }
 
     FLogManager(std::unique_ptr<FLogConfig> p_Config) noexcept
-      #if(USE_MICROSERVICE)
-          :mWritterUtility(std::string(p_Config->data().server_ip +":"+ p_Config->data().server_port)),
-      #else
-          :mWritterUtility(std::string(p_Config->data().log_file_path +"/"+ p_Config->data().log_file_name)),
-      #endif
-         mAsyncBuffer(new FLogCircularBuffer<FLogLine>(p_Config->data().size_of_ring_buffer)){
+        :FLogManager(p_Config->data(), ""){
 
         p_Config.swap(mConfig);
     }
 
+    // p_Name: empty for the global logger, the category name otherwise.
+    FLogManager(const flashlogger_config_data& p_Data, std::string p_Name) noexcept
+         :mName(std::move(p_Name)),
+         mAsyncBuffer(MakeRing(p_Data)),
+         mRenderer(FLogOutputFormatFrom(p_Data.output_format)),
+         mFormatThreads(p_Data.format_threads),
+         mWritterUtility(p_Data){
+
+        // a shared memory ring is written to the file by flashlogd, nothing to index here.
+        // only a primary sink with a file behind it has offsets to index.
+        if (p_Data.index_every && mAsyncBuffer->ShmName().empty() && mWritterUtility.Fd() >= 0){
+            mIndex.Open(p_Data.log_file_path + "/" + p_Data.log_file_name + ".idx", p_Data.index_every);
+        }
+        // a category spills to a file of its own. a shared memory ring has no consumer here.
+        if (!p_Data.spill_file.empty() && mAsyncBuffer->ShmName().empty() &&
+            mSpill.Open(mName.empty() ? p_Data.spill_file : p_Data.spill_file + "." + mName, std::size_t{p_Data.spill_mb} * 1024 * 1024)){
+            const std::size_t slots = mAsyncBuffer->Slots();
+            mSpillHigh = std::clamp<std::size_t>(slots * std::min(p_Data.spill_high, 100u) / 100, 1, slots);
+            mSpillLow = std::min<std::size_t>(slots * std::min(p_Data.spill_low, 100u) / 100, mSpillHigh - 1);
+        }
+        // categories copy the global settings, only the global logger captures.
+        if (!p_Data.capture_file.empty() && mName.empty()){
+            mCapture.Open(p_Data.capture_file);
+        }
+        // spans are logged to the global logger, a shared memory ring is rendered by flashlogd.
+        if (!p_Data.trace_file.empty() && mName.empty() && mAsyncBuffer->ShmName().empty() &&
+            !mTraceFile.Open(p_Data.trace_file)){
+            std::cerr << "FlashLogger: cannot open trace_file " << p_Data.trace_file << std::endl;
+        }
+    }
+
     void SetCopyrightAndStartService(const std::string& p_Data){
 
-        mWritterUtility.WriteToFile((std::uint8_t*)p_Data.c_str(), p_Data.length());
-        // Configure the essential ENV variables
-        std::string val = []()->const char* { if (char* buf=::getenv("FLOG_LOG_LEVEL")) return buf; return " "; }();
-        FLogManager::SetLogLevel(val);
-        val = []()->const char* { if (char* buf=::getenv("FLOG_GRANULARITY")) return buf; return " "; }();
-        FLogManager::SetLogGranularity(val);
+        WriteCopyright(p_Data);
+        ApplySettings(mConfig->data());
+        // Configure the essential ENV variables, they win over the config file at start up.
+        if (const char* level = ::getenv("FLOG_LOG_LEVEL")) SetLogLevel(level);
+        if (const char* granularity = ::getenv("FLOG_GRANULARITY")) SetLogGranularity(granularity);
+
+        for (const auto& spec : mConfig->data().categories){
+            StartCategory(spec, p_Data);
+        }
+
+        if (mConfig->data().crash_handler){
+            InstallCrashHandler();
+        }
+
+        StartService(mConfig->data().background_threads != 0);
+
+        if (mConfig->data().warm_up){
+            WarmUp();
+        }
+
+        if (mConfig->data().hot_reload){
+            mConfigWatcher.Start(mConfig->file_name(), [this](){ Reload(); });
+        }
+    }
+
+    // Re-reads the config file and applies the live settings to this logger and to every
+    // category already running. called by the watcher thread on file change or SIGHUP.
+    void Reload(){
+
+        try{
+            const flashlogger_config_data fresh = mConfig->reload();
+            ApplySettings(fresh);
+            for (const auto& spec : fresh.categories){
+                const auto [name, data] = ParseCategory(spec, fresh);
+                FLogManager& logger = Category(name);
+                if (&logger != this){
+                    logger.ApplySettings(data);
+                }
+            }
+            std::cout << "FlashLogger: reloaded " << mConfig->file_name() << std::endl;
+        }catch(const std::exception& exp){
+            std::cerr << "FlashLogger: reload failed, settings unchanged: " << exp.what() << std::endl;
+        }
+    }
+
+    // only the settings which are safe to change while lines are being logged.
+    void ApplySettings(const flashlogger_config_data& p_Data) noexcept{
+
+        if (!p_Data.log_level.empty()) SetLogLevel(p_Data.log_level);
+        if (!p_Data.granularity.empty()) SetLogGranularity(p_Data.granularity);
+        mLimitersEnabled.store(p_Data.rate_limit != 0, std::memory_order_relaxed);
+        mFlushEvery.store(p_Data.flush_every, std::memory_order_relaxed);
+        mDurability.store(FLogDurabilityFrom(p_Data.durability), std::memory_order_relaxed);
+        mFsyncIntervalMs.store(p_Data.fsync_interval_ms, std::memory_order_relaxed);
+        mBacktraceDepth.store(std::min<std::size_t>(p_Data.backtrace, FLogBacktrace::MAX_ENTRIES), std::memory_order_relaxed);
+        SetTraceSpans(p_Data.trace_spans != 0);
+        if (p_Data.profile_sites){
+            FLogTickClock::Calibrate();
+        }
+        mProfileReportNanos.store(std::uint64_t(p_Data.profile_report_s) * 1000000000, std::memory_order_relaxed);
+        mProfileSites.store(p_Data.profile_sites != 0, std::memory_order_relaxed);
+        mWritterUtility.SetLevels(p_Data.sink_levels);
+    }
+
+    // FlashLogger.profile_sites: the p_Top noisiest call sites of every logger, by bytes written.
+    static std::vector<FLogSiteReport> SiteReport(std::size_t p_Top = 10){
+
+        std::vector<const FLogSiteTable*> tables{&globalInstance().mSites};
+        std::lock_guard<std::mutex> lock(CategoriesMutex());
+        for (const auto& logger : Categories()){
+            tables.push_back(&logger->mSites);
+        }
+        return FLogSiteProfiler::Report(tables, p_Top);
+    }
+
+    // one string lookup, keep the reference (FLOG_CATEGORY does) instead of calling per line.
+    static FLogManager& Category(std::string_view p_Name){
+
+        std::lock_guard<std::mutex> lock(CategoriesMutex());
+        for (auto& logger : Categories()){
+            if (logger->mName == p_Name) return *logger;
+        }
+        return globalInstance();
+    }
+
+    const std::string& Name() const noexcept{ return mName; }
+
+    // without constructing the global logger: a logger of its own may run with none.
+    bool IsGlobal() const noexcept{ return sGlobal.load(std::memory_order_acquire) == this; }
+
+    // Opt-in: on SIGSEGV/SIGBUS/SIGABRT/SIGFPE/SIGILL write every committed line to the sink,
+    // append a marker and re-raise. The log call itself is unchanged.
+    void InstallCrashHandler(){
+
+        mCrashRenderer = std::make_unique<FLogRecordRenderer>(mRenderer.Format(), true);
+        // categories belong to the global logger, a logger of its own flushes itself only.
+        if (IsGlobal()){
+            std::lock_guard<std::mutex> lock(CategoriesMutex());
+            for (auto& logger : Categories()){
+                logger->AddCrashTarget();
+            }
+        }
+        sCrashTarget = this;
+        FLogCrashHandler::Install(&FLogManager::FlushOnFatalSignal);
+    }
+
+private:
+    // a shared memory ring which cannot be set up (bad shm_name, /dev/shm full, no access)
+    // falls back to a ring on the heap, drained by this process as without shm_name.
+    static FLogCircularBuffer<FLogLine>* MakeRing(const flashlogger_config_data& p_Data){
+
+        try{
+            return new FLogCircularBuffer<FLogLine>(p_Data.size_of_ring_buffer, FLogShmRingName(p_Data.shm_name, getpid()));
+        }catch(const std::runtime_error& exp){
+            std::cerr << "FlashLogger: " << exp.what() << ", lines are written by this process" << std::endl;
+            return new FLogCircularBuffer<FLogLine>(p_Data.size_of_ring_buffer);
+        }
+    }
+
+    void WriteCopyright(const std::string& p_Data){
+
+        // a shared memory ring is drained by flashlogd, keep it to records only.
+        const bool drainedByDaemon = !mAsyncBuffer->ShmName().empty();
+
+        // json and binary outputs are meant for machines, keep them parseable from the first byte.
+        if (mRenderer.Format() == FLogOutputFormat::TEXT && !drainedByDaemon){
+            mWritterUtility.WriteToFile((std::uint8_t*)p_Data.c_str(), p_Data.length());
+        }
+    }
+
+    // "<name> ring=4096 file=market_data.txt level=INFO granularity=FULL format=json",
+    // settings not given are taken from the global logger.
+    std::pair<std::string, flashlogger_config_data> ParseCategory(const std::string& p_Spec,
+                                                                  const flashlogger_config_data& p_Base) const{
+
+        std::istringstream in(p_Spec);
+        std::string name, token;
+        in >> name;
+
+        flashlogger_config_data data = p_Base;
+        data.categories.clear();
+        data.log_level = LevelName(mCurrentLevel.load(std::memory_order_relaxed));
+        data.granularity = IsFull() ? "FULL" : "BASIC";
+        data.log_file_name = name + ".txt";
+        // flashlogd picks "<prefix>.*" up, category rings are merged with the others.
+        data.shm_name = data.shm_name.empty() ? "" : data.shm_name + "." + name;
+        while (in >> token){
+            const auto eq = token.find('=');
+            const std::string key = token.substr(0, eq);
+            const std::string value = (eq == std::string::npos) ? "" : token.substr(eq + 1);
+            if (key == "ring") data.size_of_ring_buffer = static_cast<short>(std::stoi(value));
+            else if (key == "file") data.log_file_name = value;
+            else if (key == "format") data.output_format = value;
+            else if (key == "level") data.log_level = value;
+            else if (key == "granularity") data.granularity = value;
+            else if (key == "rate_limit") data.rate_limit = static_cast<short>(std::stoi(value));
+            else if (key == "flush_every") data.flush_every = std::stoul(value);
+            else if (key == "backtrace") data.backtrace = std::stoul(value);
+            else if (key == "index_every") data.index_every = std::stoul(value);
+            else if (key == "sink_levels") data.sink_levels = value;
+            else if (key == "durability") data.durability = value;
+            else if (key == "fsync_interval_ms") data.fsync_interval_ms = std::stoul(value);
+            else std::cerr << "FlashLogger.category " << name << ": unknown setting " << token << std::endl;
+        }
+        return {name, data};
+    }
+
+    void StartCategory(const std::string& p_Spec, const std::string& p_Copyright){
+
+        const auto [name, data] = ParseCategory(p_Spec, mConfig->data());
+        if (name.empty()) return;
+
+        auto logger = std::make_unique<FLogManager>(data, name);
+        logger->ApplySettings(data);
+        logger->WriteCopyright(p_Copyright);
+        logger->StartService(data.background_threads != 0);
+
+        std::lock_guard<std::mutex> lock(CategoriesMutex());
+        if (sCrashTarget == this){
+            logger->AddCrashTarget();
+        }
+        Categories().push_back(std::move(logger));
+    }
+
+    static const char* LevelName(LEVEL p_Level) noexcept{
+
+        return p_Level == LEVEL::INFO ? "INFO" : p_Level == LEVEL::WARN ? "WARN" : "CRIT";
+    }
+
+    // destroyed before the global logger, every category drains and joins first.
+    static std::vector<std::unique_ptr<FLogManager>>& Categories(){
+
+        static std::vector<std::unique_ptr<FLogManager>> s_Categories;
+        return s_Categories;
+    }
+
+    static std::mutex& CategoriesMutex(){
+
+        static std::mutex s_Mutex;
+        return s_Mutex;
+    }
+
+    void StartService(bool p_Threaded){
+
+        // a shared memory ring is drained by flashlogd, this process runs no consumer thread.
+        const bool drainedByDaemon = !mAsyncBuffer->ShmName().empty();
+        mDrainedByDaemon = drainedByDaemon;
+        mThreadless = !p_Threaded;
+        mSyncer.Start(drainedByDaemon ? -1 : mWritterUtility.Fd(), [this](std::uint64_t p_Lines){ OnSynced(p_Lines); }, p_Threaded);
+        if (mThreadless){
+            return;
+        }
+
+        // a shared memory ring is rendered by flashlogd.
+        if (mFormatThreads && !drainedByDaemon){
+            mFormatters = std::make_unique<FLogFormatterPool>(mFormatThreads, mRenderer.Format());
+        }
 
         mTasksFutures.reserve(2);
         std::packaged_task<bool(void)> taskProd(std::bind(&FLogManager::ProducerThreadRun, this));
         mTasksFutures.push_back(std::move(taskProd.get_future()));
         std::packaged_task<bool(void)> taskCons(std::bind(&FLogManager::ConsumerThreadRun, this));
-        mTasksFutures.push_back(std::move(taskCons.get_future()));
+        if (!drainedByDaemon){
+            mTasksFutures.push_back(std::move(taskCons.get_future()));
+        }
 
         std::thread t1(std::move(taskProd));
-        std::thread t2(std::move(taskCons));
+        std::thread t2 = drainedByDaemon ? std::thread() : std::thread(std::move(taskCons));
 
         uint noOfLogicalCores = std::thread::hardware_concurrency();
         cpu_set_t cpuset;
@@ -115,71 +393,247 @@ public:
             CPU_SET(cpu_index, &cpuset);
         }
         int rc = pthread_setaffinity_np(t1.native_handle(),sizeof(cpu_set_t), &cpuset);
-        rc += pthread_setaffinity_np(t2.native_handle(),sizeof(cpu_set_t), &cpuset);
+        if (t2.joinable()){
+            rc += pthread_setaffinity_np(t2.native_handle(),sizeof(cpu_set_t), &cpuset);
+            t2.detach();
+        }
         if (rc != 0) {
             std::cerr << "Error calling pthread_setaffinity_np: " << rc << std::endl;
         }
 
         t1.detach();
-        t2.detach();
     }
 
-    const FLogLine& getFlogLine(const LEVEL p_Level, const char* f, std::uint32_t l){
-        return [p_Level, f, l]()->const FLogLine&{
-            static FLogLine flog;
-            static FLogLineDummy flogDummy;
-            if (FLogManager::toLog(p_Level)){
-                if (FLogManager::IsFull()){
-                    flog.InitData(FLogNow(), f,l);
-                }
-                return flog;
+public:
+    // p_SitePass: verdict of a per call site limiter (FLOG_*_ONCE/_EVERY_N/_RATE).
+    // inlined at every call site: the level check and nothing else, see getFlogLineExtras.
+    const FLogLine& getFlogLine(const LEVEL p_Level, const char* f, std::uint32_t l, const bool p_SitePass = true){
+
+        if (mBacktraceDepth.load(std::memory_order_relaxed) == 0 && !mProfileSites.load(std::memory_order_relaxed)){
+            if (!p_SitePass || !toLog(p_Level)){
+                return mLineDummy;
+            }
+            if (IsFull()){
+                InitLine(f, l, p_Level);
             }
-            return flogDummy;
-        }();
+            return mLine;
+        }
+        return getFlogLineExtras(p_Level, f, l, p_SitePass);
     }
 
-    static void SetLogLevel(std::string p_level)noexcept{
+    FLOG_NOINLINE void InitLine(const char* f, std::uint32_t l, const LEVEL p_Level){
+
+        mLine.InitData(FLogNow(), f, l, p_Level);
+    }
+
+    // backtrace and/or site profiling configured.
+    FLOG_COLD const FLogLine& getFlogLineExtras(const LEVEL p_Level, const char* f, std::uint32_t l, const bool p_SitePass){
+
+        const bool profile = mProfileSites.load(std::memory_order_relaxed);
+        const std::uint64_t start = profile ? FLogTickClock::Now() : 0;
+        const bool backtrace = mBacktraceDepth.load(std::memory_order_relaxed) != 0;
+        // with a backtrace every CRIT line is written, right after the context kept for it.
+        if (p_SitePass && (toLog(p_Level) || (backtrace && p_Level == LEVEL::CRIT))){
+            if (backtrace && p_Level == LEVEL::CRIT){
+                DumpBacktrace();
+            }
+            if (profile){
+                FLogSiteProfiler::Begin(f, l, true, start);
+            }
+            if (IsFull()){
+                mLine.InitData(FLogNow(), f, l, p_Level);
+            }
+            return mLine;
+        }
+        if (profile){
+            FLogSiteProfiler::Begin(f, l, false, start);
+        }
+        if (p_SitePass && backtrace){
+            FLogBacktrace::Begin(this, FLogHeader{FLogNow(), f, l, p_Level});
+            return mLineBacktrace;
+        }
+        return mLineDummy;
+    }
+
+    // Completes once every line whose end was logged before this call is in the sinks (write(2)
+    // for a file, the lanes' sinks included), with p_Durable also fdatasync'ed. The caller never waits for I/O: it can
+    // poll the future (wait_for(0s)) from a latency critical thread.
+    // The future throws std::future_error (broken promise) if the logger stops first.
+    std::future<void> Flush(bool p_Durable = false){
+
+        std::promise<void> done;
+        auto future = done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mFlushMutex);
+            mFlushRequests.push_back(FlushRequest{mPushedLines.load(std::memory_order_acquire), p_Durable, false, 0, std::move(done)});
+        }
+        mFlushRequested.store(true, std::memory_order_release);
+        return future;
+    }
+
+    // Once per logging thread, before its latency matters: its thread locals, the allocator's
+    // per thread cache and a few stack pages are set up, then p_Lines lines go through the
+    // same path as FLOG_INFO. the consumer drops them (FLOG_WARM_UP_LINE), nothing is written.
+    FLOG_COLD void PrepareThread(std::size_t p_Lines = 16){
+
+        FLogThreadId();
+        FLogCoarseNanos();
+        FLogBacktrace::PrepareThread();
+        if (mProfileSites.load(std::memory_order_relaxed)){
+            FLogSiteProfiler::PrepareThread();
+        }
+        PrefaultStack();
+        for (std::size_t i = 0; i < p_Lines; ++i){
+            const auto n = static_cast<unsigned int>(i);
+            InitLine("FLogWarmUp", FLOG_WARM_UP_LINE, LEVEL::INFO);
+            (FLogLine() = mLine).kv("warm_up", n) << "FLogWarmUp" << n << -static_cast<int>(n) << 0.5 * n;
+        }
+    }
+
+    // the first calls deep into the renderer or a sink must not fault stack pages in one by one.
+    FLOG_NOINLINE static void PrefaultStack() noexcept{
+
+        volatile std::uint8_t pages[32 * 1024];
+        for (std::size_t i = 0; i < sizeof(pages); i += 4096){
+            pages[i] = 0;
+        }
+    }
+
+    // Once at start up (FlashLogger.warm_up = 1 does it after StartService): PrepareThread()
+    // for the calling thread, the time zone, the tick clock, then waits until the consumer has
+    // taken the warm up lines, so the renderer and the sink buffers are set up too.
+    // the global logger warms every category as well.
+    FLOG_COLD void WarmUp(){
+
+        ::tzset();
+        const time_t now = ::time(nullptr);
+        tm local;
+        ::localtime_r(&now, &local);
+        FLogTickClock::Calibrate();
+
+        PrepareThread();
+        auto done = Flush();
+        while (mThreadless && done.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            Poll();
+        }
+        done.wait();
+
+        if (IsGlobal()){
+            std::lock_guard<std::mutex> lock(CategoriesMutex());
+            for (auto& logger : Categories()){
+                logger->WarmUp();
+            }
+        }
+    }
+
+    // Writes the lines of this logger the calling thread kept in its backtrace, oldest first,
+    // between two marker lines. Called by FLOG_CRIT or on demand; dumped lines are forgotten.
+    FLOG_COLD std::size_t DumpBacktrace(){
+
+        bool first = true;
+        const std::size_t dumped = FLogBacktrace::Drain(this, mBacktraceDepth.load(std::memory_order_relaxed),
+                                                        [this, &first](const std::uint8_t* p_Record, std::size_t p_Length){
+            if (first){
+                AddProdMsg(ProducerMsg(false, {FLogHeader{FLogNow(), "FLogBacktrace", 0, LEVEL::CRIT}}));
+                AddProdMsg(ProducerMsg(true, {"****** backtrace: lines below the level ******"}));
+                first = false;
+            }
+            AddProdMsg(ProducerMsg(p_Record, std::min(p_Length, MAX_SLOT_LEN)));
+        });
+        if (dumped){
+            AddProdMsg(ProducerMsg(false, {FLogHeader{FLogNow(), "FLogBacktrace", 0, LEVEL::CRIT}}));
+            AddProdMsg(ProducerMsg(true, {"****** end of backtrace, lines: ", static_cast<unsigned int>(dumped), " ******"}));
+        }
+        return dumped;
+    }
+
+    // Null Object decision only, the line pushes its own header later (FLOG_*_FMT_DEDUP).
+    const FLogLine& getFlogLineDeferred(const LEVEL p_Level){
+
+        return toLog(p_Level) ? mLine : static_cast<const FLogLine&>(mLineDummy);
+    }
+
+    void SetLogLevel(std::string p_level)noexcept{
 
         if (p_level.empty()) return;
-        mCurrentLevel = (p_level == "INFO" ? LEVEL::INFO :
-                         p_level == "WARN" ? LEVEL::WARN : LEVEL::CRIT);
+        mCurrentLevel.store(p_level == "INFO" ? LEVEL::INFO :
+                            p_level == "WARN" ? LEVEL::WARN : LEVEL::CRIT, std::memory_order_relaxed);
     }
 
-    static void SetLogGranularity(std::string p_granularity)noexcept{
+    void SetLogGranularity(std::string p_granularity)noexcept{
 
         if (p_granularity.empty()) return;
-        mCurrentGranularity = (p_granularity == "BASIC" ? GRANULARITY::BASIC : GRANULARITY::FULL);
+        mCurrentGranularity.store(p_granularity == "BASIC" ? GRANULARITY::BASIC : GRANULARITY::FULL,
+                                  std::memory_order_relaxed);
+    }
+
+    inline bool toLog(LEVEL p_level)const noexcept{
+
+        return (mCurrentLevel.load(std::memory_order_relaxed) >= p_level);
+    }
+
+    inline bool IsFull()const noexcept{
+
+        return (mCurrentGranularity.load(std::memory_order_relaxed) == GRANULARITY::FULL);
     }
 
-    static inline bool toLog(LEVEL p_level)noexcept{
+    // FlashLogger.trace_spans alone, the other live settings stay as they are.
+    void SetTraceSpans(bool p_Enabled) noexcept{
 
-        return (mCurrentLevel >= p_level);
+        if (p_Enabled){
+            FLogTickClock::Calibrate();
+        }
+        mTraceSpans.store(p_Enabled, std::memory_order_relaxed);
     }
 
-    static inline bool IsFull()noexcept{
+    inline bool TraceSpans()const noexcept{
 
-        return (mCurrentGranularity == GRANULARITY::FULL);
+        return mTraceSpans.load(std::memory_order_relaxed);
+    }
+
+    // end of a FLOG_SCOPE_TIMER / FLOG_TRACE_SPAN started at p_Start ticks.
+    void TraceSpan(const char* p_Name, std::uint64_t p_Start, const char* p_Function, std::uint32_t p_Line){
+
+        const std::uint64_t ticks = FLogTickClock::Now() - p_Start;
+        AddProdMsg(ProducerMsg(true, {FLogHeader{FLogNow(), p_Function, p_Line, LEVEL::INFO},
+                                      FLogSpan{p_Name, ticks, FLogThreadId()}}));
+    }
+
+    // FlashLogger.rate_limit = 0 lets every FLOG_*_ONCE/_EVERY_N/_RATE/_FMT_DEDUP line through.
+    inline bool LimitersEnabled()const noexcept{
+
+        return mLimitersEnabled.load(std::memory_order_relaxed);
     }
 
     // Multiple Threads can add message to message Box so must be syncronized per log line.
-    friend void AddProdMsgExternal(ProducerMsg&& p_Msg);
+    friend void AddProdMsgExternal(FLogManager* p_Owner, ProducerMsg&& p_Msg);
     void AddProdMsg(ProducerMsg&& p_Msg) noexcept{
 
         try{
             while(true){
-                static std::size_t s_count = 0;
                 if (!mProdMutex.try_lock()){
                     std::this_thread::sleep_for(std::chrono::microseconds(5));
                     continue;
                 }
-                ++s_count;
+                if (++mProdLockCount == 1){
+                    HoldBox();
+                }
+                if (mCapture.IsOpen()){
+                    mCapture.Add(p_Msg);
+                }
+                const bool isEnd = p_Msg.isEnd;
                 mProdMessageBox.push_back(std::move(p_Msg));
-                if (p_Msg.isEnd){
+                if (isEnd){
 
-                    ++s_count;
-                    while(--s_count) {
+                    mPushedLines.fetch_add(1, std::memory_order_release);
+                    // the depth is taken while the box is still ours: the next thread's
+                    // ++mProdLockCount may run as soon as the last unlock returns.
+                    const std::size_t depth = std::exchange(mProdLockCount, 0);
+                    mBoxHeld.store(false, std::memory_order_release);
+                    for (std::size_t i = 0; i < depth; ++i){
                         mProdMutex.unlock();
                     }
+                    FLogSiteProfiler::End();
                 }
                 break;
             }
@@ -188,30 +642,44 @@ public:
         }
     }
 
+    // background_threads = 0 only: moves pending lines into the ring and writes up to
+    // p_Budget records to the sink, then returns without waiting. the global logger also
+    // polls the categories. call from one thread, e.g. the host's idle loop or a timerfd.
+    // returns the number of records written.
+    std::size_t Poll(std::size_t p_Budget = 64){
+
+        if (!mThreadless){
+            return 0;
+        }
+        std::size_t written = 0;
+        MoveBoxToRing(false);
+        while (!mDrainedByDaemon && written < p_Budget && ConsumeOne()){
+            ++written;
+        }
+        // slots just freed take what did not fit before.
+        MoveBoxToRing(false);
+
+        if (IsGlobal()){
+            std::lock_guard<std::mutex> lock(CategoriesMutex());
+            for (auto& logger : Categories()){
+                written += logger->Poll(p_Budget);
+            }
+        }
+        return written;
+    }
+
     // Single Producer Single Consumer. SPSC.
     bool ProducerThreadRun(){
 
-        std::once_flag startConsumer;
         try{
             while (true){
-                if (!mProdMutex.try_lock()){
+                // read before draining, a flag seen after the unlock could hide lines added meanwhile.
+                const bool exiting = mHostAppExited.load(std::memory_order_acquire);
+                if (!MoveBoxToRing(true)){
                     std::this_thread::sleep_for(std::chrono::microseconds(5));
                     continue;
                 }
-                while (!mProdMessageBox.empty()){
-                    const auto& data = mProdMessageBox.front();
-                    while(true){
-                        if (!mAsyncBuffer->WriteData(data)){
-                            std::this_thread::sleep_for(std::chrono::microseconds(5));
-                            continue;
-                        }
-                        mProdMessageBox.pop_front();
-                        break;
-                    }
-                    std::call_once(startConsumer, [this](){ mStartReader.store(true, std::memory_order_relaxed); });
-                }
-                mProdMutex.unlock();
-                if (mHostAppExited.load(std::memory_order_relaxed)){
+                if (exiting){
 
                     return true;
                 }
@@ -230,22 +698,16 @@ public:
 
         while(true){
             try{
-                std::uint8_t* start = nullptr; std::size_t end, pos;
-                if (mAsyncBuffer->ReadData(&start, end, pos)){
-                    if (mWritterUtility.WriteToFile(start, std::min(MAX_SLOT_LEN, end))){
-                        mAsyncBuffer->UnlockReadPos(pos);
-                    }
-                }else{
+                if (!(mFormatters ? ConsumeBatches() : ConsumeOne())){
                     std::this_thread::sleep_for(std::chrono::microseconds(5));
                 }
 
                 if (mConsExit.load(std::memory_order_relaxed)){
-                    std::uint8_t* start = nullptr; std::size_t end;
-                    while (!mAsyncBuffer->FlushBuffer(&start, end)){
-                        if (end != 0){
-                            mWritterUtility.WriteToFile(start, std::min(MAX_SLOT_LEN, end));
-                        }
+                    // batches still with the formatters come before what is left in the ring.
+                    while (mFormatters && !mFormatters->Empty()){
+                        ConsumeBatches();
                     }
+                    FinishSink();
                     return true;
                 }
 
@@ -257,13 +719,512 @@ public:
     }
 
 private:
+    // producer step: message box -> ring. p_WaitForRing: wait for the consumer when the ring
+    // is full (producer thread), otherwise leave the rest in the box (Poll). a line cut there
+    // stays open in the ring's current slot and goes on at the next call.
+    // false if a logging thread holds the box.
+    bool MoveBoxToRing(bool p_WaitForRing){
+
+        if (!mProdMutex.try_lock()){
+            return false;
+        }
+        HoldBox();
+        while (!mProdMessageBox.empty()){
+            const auto& data = mProdMessageBox.front();
+            if (!mAsyncBuffer->WriteData(data)){
+                if (!p_WaitForRing) break;
+                std::this_thread::sleep_for(std::chrono::microseconds(5));
+                continue;
+            }
+            // flashlogd owns the sink, a line in the shared ring is as far as this process goes.
+            if (mDrainedByDaemon && data.isEnd){
+                ++mWrittenLines;
+            }
+            mProdMessageBox.pop_front();
+            if (!mStartReader.load(std::memory_order_relaxed)){
+                mStartReader.store(true, std::memory_order_relaxed);
+            }
+        }
+        if (mCapture.IsOpen()){
+            mCapture.Take(mCaptureBytes);
+        }
+        mBoxHeld.store(false, std::memory_order_release);
+        mProdMutex.unlock();
+        if (!mCaptureBytes.empty()){
+            mCapture.Write(mCaptureBytes);
+        }
+        if (mDrainedByDaemon && mFlushRequested.load(std::memory_order_acquire)){
+            ServiceFlush(false);
+        }
+        return true;
+    }
+
+    // consumer step: renders and writes one record. false if the ring is empty.
+    bool ConsumeOne(){
+
+        const std::uint8_t* record = nullptr; std::size_t length, pos;
+        bool critLine = false, spilled = false;
+        const bool consumed = Spill() || ReadRecord(record, length, pos, spilled);
+        if (record){
+            const auto renderedLength = mRenderer.Render(record, length);
+            if (WriteRecord(record, length, mRenderer.Data(), renderedLength, critLine)){
+                ReleaseRecord(pos, spilled);
+            }
+        }else if (!consumed){
+            mWritterUtility.Idle();
+        }
+
+        SiteReportIfDue();
+        RepeatReportIfDue();
+        const bool sync = SyncDue(critLine);
+        if (sync || mFlushRequested.load(std::memory_order_acquire)){
+            ServiceFlush(sync);
+        }
+        return consumed;
+    }
+
+    // consumer step with format_threads: cuts the ring into batches for the formatters, then
+    // writes the rendered batches in order. false if there was nothing to do.
+    bool ConsumeBatches(){
+
+        bool progress = Spill();
+        while (FLogFormatterPool::Batch* batch = mFormatters->Acquire()){
+            const std::uint8_t* record = nullptr; std::size_t length, pos;
+            bool spilled = false;
+            while (batch->Count() < FLogFormatterPool::BATCH_RECORDS && ReadRecord(record, length, pos, spilled)){
+                batch->Add(record, length);
+                ReleaseRecord(pos, spilled);
+            }
+            const bool full = batch->Count() == FLogFormatterPool::BATCH_RECORDS;
+            progress |= batch->Count() != 0;
+            mFormatters->Submit(batch);
+            if (!full) break;
+        }
+
+        bool critLine = false;
+        while (FLogFormatterPool::Batch* batch = mFormatters->Front()){
+            std::size_t length, renderedLength;
+            for (; batch->written < batch->Count(); ++batch->written){
+                const std::uint8_t* record = batch->Record(batch->written, length);
+                const std::uint8_t* rendered = batch->Rendered(batch->written, renderedLength);
+                if (!WriteRecord(record, length, rendered, renderedLength, critLine)) break;
+            }
+            // the primary sink failed: the rest of the batch is retried next time.
+            if (batch->written < batch->Count()) break;
+            mFormatters->PopFront();
+            progress = true;
+        }
+        if (!progress){
+            mWritterUtility.Idle();
+        }
+
+        SiteReportIfDue();
+        RepeatReportIfDue();
+        const bool sync = SyncDue(critLine);
+        if (sync || mFlushRequested.load(std::memory_order_acquire)){
+            ServiceFlush(sync);
+        }
+        return progress;
+    }
+
+    // consumer: past the high water mark, moves up to a batch of ring records to the spill file
+    // and keeps at it until the ring is under the low water mark. true if records were moved.
+    bool Spill(){
+
+        if (!mSpill.IsOpen()) return false;
+        if (!mSpilling){
+            if (!mAsyncBuffer->Holds(mSpillHigh)) return false;
+            mSpilling = true;
+        }
+        std::size_t moved = 0;
+        std::uint8_t* start = nullptr; std::size_t end, pos;
+        // room for a full slot first: a record read out of the ring has to go somewhere. a full
+        // file leaves it in the ring, which waits for the sink as it would without the file.
+        while (moved < FLogFormatterPool::BATCH_RECORDS && mAsyncBuffer->Holds(mSpillLow + 1) &&
+               mSpill.Room(MAX_SLOT_LEN) && mAsyncBuffer->ReadData(&start, end, pos)){
+            mSpill.Push(start, static_cast<std::uint32_t>(std::min(MAX_SLOT_LEN, end)));
+            mAsyncBuffer->UnlockReadPos(pos);
+            ++moved;
+        }
+        mSpilling = moved != 0 && mAsyncBuffer->Holds(mSpillLow + 1);
+        return moved != 0;
+    }
+
+    // consumer: the oldest record, from the spill file while it holds any, else from the ring.
+    bool ReadRecord(const std::uint8_t*& p_Record, std::size_t& p_Length, std::size_t& p_Pos, bool& p_Spilled){
+
+        p_Spilled = mSpill.IsOpen() && mSpill.Front(p_Record, p_Length);
+        if (p_Spilled) return true;
+        std::uint8_t* start = nullptr;
+        if (!mAsyncBuffer->ReadData(&start, p_Length, p_Pos)){
+            p_Record = nullptr;
+            return false;
+        }
+        p_Record = start;
+        p_Length = std::min(MAX_SLOT_LEN, p_Length);
+        return true;
+    }
+
+    void ReleaseRecord(std::size_t p_Pos, bool p_Spilled){
+
+        if (p_Spilled){
+            mSpill.PopFront();
+        }else{
+            mAsyncBuffer->UnlockReadPos(p_Pos);
+        }
+    }
+
+    // consumer thread: hands one rendered record to the sinks, indexes and counts it.
+    // false if the primary sink failed, the record is to be written again.
+    bool WriteRecord(const std::uint8_t* p_Record, std::size_t p_Length, const std::uint8_t* p_Rendered,
+                     std::size_t p_RenderedLength, bool& p_CritLine){
+
+        FLogItem header{};
+        p_CritLine |= InspectRecord(p_Record, p_Length, p_RenderedLength, header);
+        if (header.tag == FLogTag::HEADER && header.line == FLOG_WARM_UP_LINE){
+            ++mWrittenLines;
+            return true;
+        }
+        const std::uint64_t offset = mIndex.IsOpen() ? mWritterUtility.Offset() : 0;
+        const bool written = (header.tag == FLogTag::HEADER) ? mWritterUtility.Write(header.level, p_Rendered, p_RenderedLength)
+                                                             : mWritterUtility.WriteToFile(p_Rendered, p_RenderedLength);
+        if (written){
+            // a line the primary sink's level filtered out has no bytes to index.
+            if (mIndex.IsOpen() && header.tag == FLogTag::HEADER && mWritterUtility.Offset() > offset){
+                mIndex.Add(header.now, header.level, header.str, header.line, offset, mWritterUtility.Offset());
+            }
+            ++mWrittenLines;
+            const auto flushEvery = mFlushEvery.load(std::memory_order_relaxed);
+            if (flushEvery && ++mLinesSinceFlush >= flushEvery){
+                mWritterUtility.Flush();
+                mLinesSinceFlush = 0;
+            }
+        }
+        return written;
+    }
+
+    // consumer exit: whatever is left in the spill file and the ring, then the last flush.
+    void FinishSink(){
+
+        auto write = [this](const std::uint8_t* data, std::size_t length){
+            if (!FLogIsWarmUpRecord(data, length)){
+                mWritterUtility.WriteToFile(mRenderer.Data(), mRenderer.Render(data, std::min(MAX_SLOT_LEN, length)));
+            }
+            ++mWrittenLines;
+        };
+        const std::uint8_t* record = nullptr; std::size_t length;
+        while (mSpill.IsOpen() && mSpill.Front(record, length)){
+            write(record, length);
+            mSpill.PopFront();
+        }
+        mAsyncBuffer->FlushBuffer(write);
+        WriteRepeats(0);
+        WriteSpanSummary();
+        if (IsGlobal() && mProfileSites.load(std::memory_order_relaxed)){
+            WriteSiteReport();
+        }
+        ServiceFlush(mDurability.load(std::memory_order_relaxed) != FLogDurability::NONE);
+        mIndex.Close();
+        mTraceFile.Close();
+    }
+
+    // threadless exit: Poll until the box is empty, on the destroying thread.
+    void DrainAll(){
+
+        while (true){
+            MoveBoxToRing(false);
+            while (!mDrainedByDaemon && ConsumeOne()){}
+            std::lock_guard<std::recursive_mutex> lock(mProdMutex);
+            if (mProdMessageBox.empty()) break;
+            // flashlogd has to make room first.
+            std::this_thread::sleep_for(std::chrono::microseconds(5));
+        }
+        if (!mDrainedByDaemon){
+            FinishSink();
+        }
+    }
+
+    // consumer thread: is it a CRIT line (durability = crit)? spans are added to the summary,
+    // p_Rendered bytes to the call site's volume. p_Header: the record's header for the index.
+    bool InspectRecord(const std::uint8_t* p_Record, std::size_t p_Length, std::size_t p_Rendered, FLogItem& p_Header){
+
+        FLogRecordReader reader(p_Record, p_Length);
+        if (!reader.Next(p_Header) || p_Header.tag != FLogTag::HEADER) return false;
+        if (p_Header.line == FLOG_WARM_UP_LINE) return false;
+        const bool crit = p_Header.level == LEVEL::CRIT;
+        if (mProfileSites.load(std::memory_order_relaxed)){
+            FLogSiteProfiler::Written(mSites, p_Header.str, p_Header.line, p_Rendered);
+        }
+        FLogItem item;
+        if (reader.Next(item) && item.tag == FLogTag::SPAN){
+            mSpanStats.Add(item.str, FLogTickClock::ToNanos(item.ticks));
+            if (mTraceFile.IsOpen()){
+                mTraceFile.Add(p_Header, item);
+            }
+        }
+        return crit;
+    }
+
+    // global logger's consumer: the site report every FlashLogger.profile_report_s.
+    void SiteReportIfDue(){
+
+        const std::uint64_t period = mProfileReportNanos.load(std::memory_order_relaxed);
+        if (!period || !IsGlobal() || !mProfileSites.load(std::memory_order_relaxed)) return;
+        const std::uint64_t now = FLogCoarseNanos();
+        if (!mLastSiteReportNanos){
+            mLastSiteReportNanos = now;
+        }else if (now - mLastSiteReportNanos >= period){
+            mLastSiteReportNanos = now;
+            WriteSiteReport();
+        }
+    }
+
+    // consumer: FLOG_*_FMT_DEDUP sites of this logger quiet for REPEAT_QUIET_NANOS get their
+    // "previous line repeated K times", checked as often.
+    void RepeatReportIfDue(){
+
+        if (!FLogDedupSite::Any()) return;
+        const std::uint64_t now = FLogCoarseNanos();
+        if (now - mLastRepeatReportNanos < REPEAT_QUIET_NANOS) return;
+        mLastRepeatReportNanos = now;
+        WriteRepeats(REPEAT_QUIET_NANOS);
+    }
+
+    // p_QuietNanos 0: every count still pending, at exit.
+    void WriteRepeats(std::uint64_t p_QuietNanos){
+
+        const std::uint64_t now = FLogCoarseNanos();
+        alignas(8) std::uint8_t record[MAX_SLOT_LEN];
+        FLogDedupSite::ForEach([&](FLogDedupSite& p_Site){
+            if (p_Site.owner != this) return;
+            const std::uint32_t repeated = p_Site.dedup.TakeRepeated(now, p_QuietNanos);
+            if (!repeated) return;
+            FLogRecordWriter writer(record, sizeof(record));
+            if (IsFull()){
+                writer.Put(FLogHeader{FLogNow(), p_Site.function, p_Site.line, p_Site.level});
+            }
+            writer.Put("previous line repeated ");
+            writer.Put(static_cast<unsigned int>(repeated));
+            writer.Put(" times");
+            mWritterUtility.Write(p_Site.level, mRenderer.Data(), mRenderer.Render(record, writer.Length()));
+        });
+    }
+
+    static unsigned int Clamp32(std::uint64_t p_Value) noexcept{
+
+        return static_cast<unsigned int>(std::min<std::uint64_t>(p_Value, UINT32_MAX));
+    }
+
+    // one record per site, noisiest first, in the sink's format.
+    void WriteSiteReport(){
+
+        alignas(8) std::uint8_t record[MAX_SLOT_LEN];
+        unsigned int rank = 0;
+        for (const auto& site : SiteReport()){
+            FLogRecordWriter writer(record, sizeof(record));
+            writer.Put(FLogHeader{FLogNow(), "FLogSiteReport", 0, LEVEL::INFO});
+            writer.Put(FLogKey{"rank"});        writer.Put(++rank);
+            writer.Put(FLogKey{"site"});        writer.Put(site.function.c_str());
+            writer.Put(FLogKey{"line"});        writer.Put(static_cast<unsigned int>(site.line));
+            writer.Put(FLogKey{"lines"});       writer.Put(Clamp32(site.lines));
+            writer.Put(FLogKey{"bytes"});       writer.Put(Clamp32(site.bytes));
+            writer.Put(FLogKey{"drops"});       writer.Put(Clamp32(site.drops));
+            writer.Put(FLogKey{"ns_per_call"}); writer.Put(Clamp32(static_cast<std::uint64_t>(site.nanosPerCall)));
+            mWritterUtility.WriteToFile(mRenderer.Data(), mRenderer.Render(record, writer.Length()));
+        }
+    }
+
+    // one record per span name, in the sink's format.
+    void WriteSpanSummary(){
+
+        alignas(8) std::uint8_t record[MAX_SLOT_LEN];
+        for (const auto& [name, h] : mSpanStats.Spans()){
+            FLogRecordWriter writer(record, sizeof(record));
+            writer.Put(FLogHeader{FLogNow(), "FLogSpanSummary", 0, LEVEL::INFO});
+            writer.Put(FLogKey{"span"});    writer.Put(name.c_str());
+            writer.Put(FLogKey{"count"});   writer.Put(Clamp32(h.count));
+            writer.Put(FLogKey{"mean_us"}); writer.Put(h.sum / h.count / 1000);
+            writer.Put(FLogKey{"min_us"});  writer.Put(h.min / 1000);
+            writer.Put(FLogKey{"p50_us"});  writer.Put(h.Quantile(0.5) / 1000);
+            writer.Put(FLogKey{"p99_us"});  writer.Put(h.Quantile(0.99) / 1000);
+            writer.Put(FLogKey{"max_us"});  writer.Put(h.max / 1000);
+            mWritterUtility.WriteToFile(mRenderer.Data(), mRenderer.Render(record, writer.Length()));
+        }
+    }
+
+    // consumer thread: is an fdatasync due by the durability policy?
+    bool SyncDue(bool p_CritLine) noexcept{
+
+        switch (mDurability.load(std::memory_order_relaxed)){
+        case FLogDurability::CRIT:
+            return p_CritLine;
+        case FLogDurability::INTERVAL:{
+            if (mWrittenLines == mSyncRequestedLines) return false;
+            const std::uint64_t now = FLogCoarseNanos();
+            if (now - mLastSyncNanos < std::uint64_t(mFsyncIntervalMs.load(std::memory_order_relaxed)) * 1000000) return false;
+            mLastSyncNanos = now;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // draining thread: lines 1..mWrittenLines are in the sink stream. pushes them to the kernel,
+    // completes the plain Flush() requests once the lanes have flushed too and hands durable
+    // ones to the syncer.
+    void ServiceFlush(bool p_Sync){
+
+        mWritterUtility.Flush();
+        const std::uint64_t flushes = mWritterUtility.Flushes();
+        bool durable = p_Sync;
+        {
+            std::lock_guard<std::mutex> lock(mFlushMutex);
+            bool waiting = false;
+            for (auto it = mFlushRequests.begin(); it != mFlushRequests.end();){
+                if (!it->flushed && it->target <= mWrittenLines && !it->lanes){
+                    it->lanes = flushes;
+                }
+                if (!it->flushed && it->lanes && mWritterUtility.LanesFlushed(it->lanes)){
+                    it->flushed = true;
+                    if (!it->durable){
+                        it->done.set_value();
+                        it = mFlushRequests.erase(it);
+                        continue;
+                    }
+                    durable = true;
+                }
+                waiting |= !it->flushed;
+                ++it;
+            }
+            mFlushRequested.store(waiting, std::memory_order_relaxed);
+        }
+        if (durable){
+            mSyncRequestedLines = mWrittenLines;
+            mSyncer.Request(mWrittenLines);
+        }
+    }
+
+    // syncer thread: lines 1..p_Lines are on the disk.
+    void OnSynced(std::uint64_t p_Lines){
+
+        std::lock_guard<std::mutex> lock(mFlushMutex);
+        for (auto it = mFlushRequests.begin(); it != mFlushRequests.end();){
+            if (it->flushed && it->target <= p_Lines){
+                it->done.set_value();
+                it = mFlushRequests.erase(it);
+            }else{
+                ++it;
+            }
+        }
+    }
+
+    // the box is mutated with mProdMutex and this flag held. the signal handler takes the flag
+    // and never gives it back, a thread that then wants the box waits for the process to die.
+    void HoldBox() noexcept{
+
+        while (mBoxHeld.exchange(true, std::memory_order_acquire)){
+            std::this_thread::sleep_for(std::chrono::microseconds(5));
+        }
+    }
+
+    // under CategoriesMutex: the handler reads the array, never Categories().
+    void AddCrashTarget(){
+
+        if (mCrashRenderer) return;
+        mCrashRenderer = std::make_unique<FLogRecordRenderer>(mRenderer.Format(), true);
+        const std::size_t count = sCrashCategoryCount.load(std::memory_order_relaxed);
+        if (count == MAX_CRASH_CATEGORIES) return;
+        sCrashCategories[count].store(this, std::memory_order_relaxed);
+        sCrashCategoryCount.store(count + 1, std::memory_order_release);
+    }
+
+    // Runs inside the signal handler: no locks, no allocation, only write(2).
+    static void FlushOnFatalSignal(int p_Signal) noexcept{
+
+        FLogManager* self = sCrashTarget;
+        if (!self) return;
+
+        const std::size_t count = sCrashCategoryCount.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < count; ++i){
+            sCrashCategories[i].load(std::memory_order_relaxed)->FlushForCrash(p_Signal);
+        }
+        self->FlushForCrash(p_Signal);
+    }
+
+    void FlushForCrash(int p_Signal) noexcept{
+
+        FLogRecordRenderer& renderer = *mCrashRenderer;
+        const int fd = mWritterUtility.FlushForCrash();
+        auto write = [&renderer, fd](const std::uint8_t* data, std::size_t length){
+            if (FLogIsWarmUpRecord(data, length)) return;
+            FLogCrashHandler::WriteAll(fd, renderer.Data(), renderer.Render(data, std::min(MAX_SLOT_LEN, length)));
+        };
+
+        // oldest first: lines with the formatters, spilled records, committed ring slots, then
+        // complete lines the producer thread has not moved yet. the box only if no thread is
+        // changing it, the crashing thread included.
+        std::size_t flushed = mFormatters ? mFormatters->ForEachPending(write) : 0;
+        flushed += mSpill.ForEach(write);
+        flushed += mAsyncBuffer->FlushBuffer(write);
+
+        alignas(FLogLine) std::uint8_t slot[MAX_SLOT_LEN];
+        FLogRecordWriter record(slot, MAX_SLOT_LEN);
+        const bool boxHeld = mBoxHeld.exchange(true, std::memory_order_acquire);
+        for (auto msg = mProdMessageBox.begin(); !boxHeld && msg != mProdMessageBox.end(); ++msg){
+            if (msg->raw){
+                write(msg->raw.get(), msg->rawLength);
+                ++flushed;
+                continue;
+            }
+            for (const auto& item : msg->data){
+                record.Put(item);
+            }
+            if (msg->isEnd){
+                write(slot, record.Length());
+                ++flushed;
+                record.Reset();
+            }
+        }
+
+        FLogRecordWriter marker(slot, MAX_SLOT_LEN);
+        marker.Put(FLogHeader{FLogNow(), "FLogCrashHandler", 0, LEVEL::CRIT});
+        marker.Put("******FLog crashed on signal ");
+        marker.Put(p_Signal);
+        marker.Put(", lines flushed: ");
+        marker.Put(static_cast<unsigned int>(flushed));
+        marker.Put("*******");
+        write(slot, marker.Length());
+    }
+
+    static constexpr std::size_t MAX_CRASH_CATEGORIES{64};
+    static inline FLogManager* sCrashTarget{nullptr};
+    static inline std::atomic<FLogManager*> sCrashCategories[MAX_CRASH_CATEGORIES]{};
+    static inline std::atomic<std::size_t> sCrashCategoryCount{0};
+    std::unique_ptr<FLogRecordRenderer> mCrashRenderer;
+
     std::unique_ptr<FLogConfig> mConfig;
+    std::string mName;
+
+    // what FLOG_* macros hand out: the live line or the Null Object.
+    FLogLine mLine{this};
+    FLogLineDummy mLineDummy;
+    FLogLineBacktrace mLineBacktrace;
 
     std::unique_ptr<FLogCircularBuffer<FLogLine>> mAsyncBuffer;
 
+    // used only by the consumer thread.
+    FLogRecordRenderer mRenderer;
+    const std::size_t mFormatThreads;
+    std::unique_ptr<FLogFormatterPool> mFormatters;
+
     std::thread mProducerThread;
     std::deque<ProducerMsg> mProdMessageBox;
     std::recursive_mutex mProdMutex;
+    // lock depth of the line being added, only touched while mProdMutex is held.
+    std::size_t mProdLockCount{0};
+    // see HoldBox.
+    std::atomic_bool mBoxHeld{false};
 
     // using spinlock instead.
     /*std::condition_variable_any mProdCondVariable;*/
@@ -272,19 +1233,84 @@ private:
 
     std::vector<std::future<bool>> mTasksFutures;
 
-    static LEVEL mCurrentLevel;
-    static GRANULARITY mCurrentGranularity;
-#if(USE_MICROSERVICE)
-    FLogWritter<FLogMicroServiceWritter> mWritterUtility;
-#else
-    FLogWritter<FLogFileWritter> mWritterUtility;
-#endif
+    std::atomic<LEVEL> mCurrentLevel{LEVEL::CRIT};
+    std::atomic<GRANULARITY> mCurrentGranularity{GRANULARITY::FULL};
+    std::atomic_bool mLimitersEnabled{true};
+    std::atomic<unsigned int> mFlushEvery{0};
+    std::atomic<std::size_t> mBacktraceDepth{0};
+    // used only by the consumer thread.
+    unsigned int mLinesSinceFlush{0};
+    FLogConfigWatcher mConfigWatcher;
+    FLogWritter<FLOG_SINKS> mWritterUtility;
+    static inline std::atomic<FLogManager*> sGlobal{nullptr};
     std::atomic_bool mHostAppExited{false};
     std::atomic_bool mConsExit{false};
     std::atomic_bool mStartReader{false};
+    bool mDrainedByDaemon{false};
+    bool mThreadless{false};
+    std::atomic_bool mTraceSpans{false};
+    // consumer thread only.
+    FLogSpanStats mSpanStats;
+    FLogTraceFile mTraceFile;
+    std::atomic_bool mProfileSites{false};
+    std::atomic<std::uint64_t> mProfileReportNanos{0};
+    std::uint64_t mLastSiteReportNanos{0};
+    static constexpr std::uint64_t REPEAT_QUIET_NANOS{1000000000};
+    std::uint64_t mLastRepeatReportNanos{0};
+    // written by the consumer, read by SiteReport().
+    FLogSiteTable mSites;
+    // consumer thread only, FlashLogger.index_every.
+    FLogIndexWriter mIndex;
+    // FlashLogger.capture_file: filled under mProdMutex, written by the producer thread.
+    FLogCaptureWriter mCapture;
+    std::string mCaptureBytes;
+    // consumer thread only, FlashLogger.spill_file. marks in ring records.
+    FLogSpillFile mSpill;
+    std::size_t mSpillHigh{0};
+    std::size_t mSpillLow{0};
+    bool mSpilling{false};
+
+    // Flush() and durability, see ServiceFlush().
+    struct FlushRequest{
+        std::uint64_t target;
+        bool durable;
+        bool flushed;
+        // the sink Flush() the lanes must have served, 0 while the primary is not there yet.
+        std::uint64_t lanes;
+        std::promise<void> done;
+    };
+    std::mutex mFlushMutex;
+    std::vector<FlushRequest> mFlushRequests;
+    std::atomic_bool mFlushRequested{false};
+    std::atomic<std::uint64_t> mPushedLines{0};
+    // owned by the draining thread (consumer, or producer with flashlogd).
+    std::uint64_t mWrittenLines{0};
+    std::uint64_t mSyncRequestedLines{0};
+    std::uint64_t mLastSyncNanos{0};
+    std::atomic<FLogDurability> mDurability{FLogDurability::NONE};
+    std::atomic<unsigned int> mFsyncIntervalMs{100};
+    // declared last: stopped (and its pending fdatasync done) before the sink closes.
+    FLogSyncer mSyncer;
 };
 
-void AddProdMsgExternal(ProducerMsg&& p_Msg){
+#if FLOG_DEFINE_EXTERNALS
+FLOG_EXTERNAL void AddProdMsgExternal(FLogManager* p_Owner, ProducerMsg&& p_Msg){
 
-    FLogManager::globalInstance().AddProdMsg(std::forward<ProducerMsg>(p_Msg));
+    p_Owner->AddProdMsg(std::forward<ProducerMsg>(p_Msg));
 }
+
+FLOG_EXTERNAL bool FLogIsFullExternal(const FLogManager* p_Owner) noexcept{
+
+    return p_Owner->IsFull();
+}
+
+FLOG_EXTERNAL bool FLogTraceEnabledExternal() noexcept{
+
+    return FLogManager::globalInstance().TraceSpans();
+}
+
+FLOG_EXTERNAL void FLogTraceSpanExternal(const char* p_Name, std::uint64_t p_Start, const char* p_Function, std::uint32_t p_Line){
+
+    FLogManager::globalInstance().TraceSpan(p_Name, p_Start, p_Function, p_Line);
+}
+#endif
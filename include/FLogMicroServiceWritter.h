@@ -24,15 +24,21 @@
 
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <unistd.h>
 
 #include <grpc/support/log.h>
 #include <grpcpp/grpcpp.h>
 
 #include "flog.grpc.pb.h"
+#include "FLogCodec.h"
+#include "FLogCrashHandler.h"
+#include "FLogRateLimit.h"
 
 using grpc::Channel;
 using grpc::ClientAsyncResponseReader;
@@ -43,13 +49,39 @@ using FLogProto::FLogRemoteLogger;
 using FLogProto::Response;
 using FLogProto::LogLine;
 
+// Design note:
+// # - lines are batched, one RPC per FlashLogger.remote_batch_kb, on Flush() and when the ring
+//     runs empty (Idle()) with the batch's first line remote_batch_ms old: a quiet logger still
+//     ships its lines within a few ms, a trickle of lines is not one RPC each.
+// # - a batch is compressed on this (the consumer) thread with FlashLogger.remote_codec, see
+//     FLogCodec.h. the dictionary is taken from the first remote_dict_lines lines and goes
+//     with the first block using it; a failed call sends it again (the server may have lost it).
 class FLogMicroServiceWritter
 {
 public:
-    explicit FLogMicroServiceWritter(const std::string& p_ServerColonPort){
+    static constexpr const char* NAME{"grpc"};
+
+    template<typename CONFIG>
+    static auto ConfigArgs(const CONFIG& p_Data){
+
+        return std::make_tuple(std::string(p_Data.server_ip + ":" + p_Data.server_port),
+                               FLogCodecFrom(p_Data.remote_codec), p_Data.remote_level,
+                               std::size_t{p_Data.remote_batch_kb} * 1024, std::size_t{p_Data.remote_dict_lines},
+                               std::uint64_t{p_Data.remote_batch_ms} * 1000000);
+    }
+
+    explicit FLogMicroServiceWritter(const std::string& p_ServerColonPort, FLogCodec p_Codec = FLogCodec::NONE,
+                                     int p_Level = 0, std::size_t p_BatchBytes = 64 * 1024, std::size_t p_DictLines = 1000,
+                                     std::uint64_t p_BatchAgeNanos = 5000000)
+        :mEncoder(p_Codec, p_Level),
+         mDictionary(p_DictLines),
+         mBatchBytes(std::max<std::size_t>(p_BatchBytes, 1)),
+         mBatchAgeNanos(p_BatchAgeNanos),
+         mTrainDictionary(p_Codec != FLogCodec::NONE && p_DictLines){
 
         stub_ = FLogRemoteLogger::NewStub(grpc::CreateChannel(
                                          p_ServerColonPort, grpc::InsecureChannelCredentials()));
+        mBatch.reserve(mBatchBytes + 4096);
         std::thread(&FLogMicroServiceWritter::AsyncCompleteRpc, this).detach();
     }
 
@@ -68,25 +100,98 @@ public:
 
             AsyncClientCall* call = static_cast<AsyncClientCall*>(got_tag);
             GPR_ASSERT(ok);
-            if (!call->status.ok())
-                assert(0);
+            if (!call->status.ok()){
+                ++mFailedCalls;
+                mResendDictionary.store(true, std::memory_order_relaxed);
+            }
             delete call;
         }
     }
 
-    bool WriteToFile(const char* data, int size) {
+    bool WriteToFile(const std::uint8_t* data, int size) {
+
+        if (mTrainDictionary && mDictionary.Feed(data, size)){
+            mTrainDictionary = false;
+            // what is batched so far goes without it.
+            Send();
+            mEncoder.SetDictionary(&mDictionary.Content());
+            mDictionaryId = mDictionary.Id();
+            mResendDictionary.store(true, std::memory_order_relaxed);
+        }
+        if (mBatch.empty()){
+            mBatchSince = FLogCoarseNanos();
+        }
+        mBatch.append(reinterpret_cast<const char*>(data), size);
+        if (mBatch.size() >= mBatchBytes){
+            Send();
+        }
+        return true;
+    }
+
+    bool Flush() {
+
+        Send();
+        return true;
+    }
+
+    // the ring is empty: the batch goes once it is old enough, the consumer polls far more
+    // often than a server wants an RPC.
+    void Idle() {
+
+        if (mBatch.empty() || FLogCoarseNanos() - mBatchSince < mBatchAgeNanos) return;
+        Send();
+    }
 
+    // bytes before and after the codec, for the bandwidth the codec saves.
+    std::uint64_t RawBytes() const noexcept{ return mRawBytes; }
+    std::uint64_t SentBytes() const noexcept{ return mSentBytes; }
+    std::uint64_t FailedCalls() const noexcept{ return mFailedCalls.load(std::memory_order_relaxed); }
+
+    // no local file to index.
+    std::uint64_t Offset() const noexcept{
+
+        return 0;
+    }
+
+    // no local file, durability is the server's business.
+    int Fd() const noexcept{
+
+        return -1;
+    }
+
+    // Fatal signal path: gRPC is not async-signal-safe, the lines batched and not sent yet go
+    // to stderr, then the caller write(2)s the ring there.
+    int FlushForCrash() noexcept{
+
+        FLogCrashHandler::WriteAll(STDERR_FILENO, reinterpret_cast<const std::uint8_t*>(mBatch.data()), mBatch.size());
+        return STDERR_FILENO;
+    }
+
+private:
+    void Send(){
+
+        if (mBatch.empty()) return;
         LogLine request;
-        std::string tmp(data, size);
-        request.set_log(std::move(tmp));
+        const FLogCodec codec = mEncoder.Encode(reinterpret_cast<const std::uint8_t*>(mBatch.data()), mBatch.size(),
+                                                *request.mutable_log());
+        request.set_codec(static_cast<FLogProto::Codec>(codec));
+        request.set_raw_size(mBatch.size());
+        if (codec != FLogCodec::NONE && mDictionaryId){
+            request.set_dict_id(mDictionaryId);
+            if (mResendDictionary.exchange(false, std::memory_order_relaxed)){
+                request.set_dictionary(mDictionary.Content());
+            }
+        }
+        mRawBytes += mBatch.size();
+        mSentBytes += request.log().size() + request.dictionary().size();
+        mBatch.clear();
+
         AsyncClientCall* call = new AsyncClientCall;
         call->response_reader = stub_->PrepareAsyncSendLogLine(&call->context, request, &cq_);
         call->response_reader->StartCall();
         call->response_reader->Finish(&call->reply, &call->status, (void*)call);
-        return true;
     }
 
-private:
     // struct for keeping state and data information
     struct AsyncClientCall {
 
@@ -97,5 +202,18 @@ private:
     };
     std::unique_ptr<FLogRemoteLogger::Stub> stub_;
     CompletionQueue cq_;
-    std::atomic_bool mResponseValidatorExit;
+    std::atomic_bool mResponseValidatorExit{false};
+
+    FLogBlockEncoder mEncoder;
+    FLogCodecDictionary mDictionary;
+    const std::size_t mBatchBytes;
+    const std::uint64_t mBatchAgeNanos;
+    std::uint64_t mBatchSince{0};
+    bool mTrainDictionary;
+    std::uint32_t mDictionaryId{0};
+    std::string mBatch;
+    std::uint64_t mRawBytes{0};
+    std::uint64_t mSentBytes{0};
+    std::atomic_bool mResendDictionary{false};
+    std::atomic<std::uint64_t> mFailedCalls{0};
 };
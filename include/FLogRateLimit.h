@@ -0,0 +1,154 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_RATE_LIMIT_HPP
+#define FLOG_RATE_LIMIT_HPP
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <time.h>
+
+// Design note:
+// # - one limiter object per macro expansion (function local static), picked at compile time.
+// # - every limiter is a relaxed atomic or two, a call site may be hit from many threads and
+//     an occasional extra or missing line under contention is accepted.
+// # - limiters run only after the level check, a disabled site never consumes its budget.
+
+struct FLogOnce{
+
+    bool Pass() noexcept{
+
+        return !mDone.load(std::memory_order_relaxed) && !mDone.exchange(true, std::memory_order_relaxed);
+    }
+
+    std::atomic_bool mDone{false};
+};
+
+template<std::uint32_t N>
+struct FLogEveryN{
+
+    static_assert(N > 0, "FLOG_*_EVERY_N needs N > 0");
+
+    bool Pass() noexcept{
+
+        return mCount.fetch_add(1, std::memory_order_relaxed) % N == 0;
+    }
+
+    std::atomic<std::uint32_t> mCount{0};
+};
+
+inline std::uint64_t FLogCoarseNanos() noexcept{
+
+    // vDSO, a few ns. resolution of a few ms is plenty for per second budgets.
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Token bucket of N_PER_SECOND tokens refilled continuously (GCRA, one atomic).
+template<std::uint32_t N_PER_SECOND>
+struct FLogRateLimit{
+
+    static_assert(N_PER_SECOND > 0, "FLOG_*_RATE needs a rate > 0");
+    static constexpr std::uint64_t INTERVAL{1000000000 / N_PER_SECOND};
+    static constexpr std::uint64_t BURST{1000000000};
+
+    bool Pass() noexcept{
+
+        const std::uint64_t now = FLogCoarseNanos();
+        std::uint64_t tat = mTheoreticalArrival.load(std::memory_order_relaxed);
+        while (true){
+            const std::uint64_t next = std::max(tat, now) + INTERVAL;
+            if (next - now > BURST)
+                return false;
+            if (mTheoreticalArrival.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    std::atomic<std::uint64_t> mTheoreticalArrival{0};
+};
+
+// Suppresses a line whose arguments hash like the previous line of the same site.
+struct FLogDedup{
+
+    // p_Repeated: how many lines were swallowed before this one, to be reported first.
+    bool Pass(std::uint64_t p_Hash, std::uint32_t& p_Repeated) noexcept{
+
+        if (mLastHash.exchange(p_Hash, std::memory_order_relaxed) == p_Hash){
+            mRepeated.fetch_add(1, std::memory_order_relaxed);
+            mLastRepeatNanos.store(FLogCoarseNanos(), std::memory_order_relaxed);
+            return false;
+        }
+        p_Repeated = mRepeated.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // the swallowed lines not reported yet, once the last one is p_QuietNanos old. a site which
+    // repeats and then goes quiet has no next line to report them with.
+    std::uint32_t TakeRepeated(std::uint64_t p_Now, std::uint64_t p_QuietNanos) noexcept{
+
+        if (mRepeated.load(std::memory_order_relaxed) == 0 ||
+            mLastRepeatNanos.load(std::memory_order_relaxed) + p_QuietNanos > p_Now){
+            return 0;
+        }
+        return mRepeated.exchange(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> mLastHash{0};
+    std::atomic<std::uint32_t> mRepeated{0};
+    std::atomic<std::uint64_t> mLastRepeatNanos{0};
+};
+
+// FNV-1a over the argument values, strings by content.
+inline void FLogHashBytes(std::uint64_t& p_Hash, const void* p_Data, std::size_t p_Length) noexcept{
+
+    const auto* bytes = static_cast<const std::uint8_t*>(p_Data);
+    for (std::size_t i = 0; i < p_Length; ++i){
+        p_Hash = (p_Hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+}
+
+template<typename... Args>
+std::uint64_t FLogHashArgs(const Args&... p_Args) noexcept{
+
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    auto one = [&hash](const auto& arg){
+        using ArgT = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_pointer_v<ArgT>){
+            const char* text = arg;
+            if (text) FLogHashBytes(hash, text, strlen(text));
+        }else{
+            FLogHashBytes(hash, &arg, sizeof(arg));
+        }
+        FLogHashBytes(hash, "\0", 1);
+    };
+    (one(p_Args), ...);
+    return hash;
+}
+
+#endif /* FLOG_RATE_LIMIT_HPP */
@@ -0,0 +1,608 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_RECORD_HPP
+#define FLOG_RECORD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <cerrno>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "FLogUtilStructs.h"
+#include "FLogTrace.h"
+
+// Design note:
+// # - a ring slot holds one record: a sequence of tagged items, no text formatting on producers.
+// # - STR/KEY : tag | u8 length | bytes
+// #   U32/I32 : tag | 4 bytes,  F64 : tag | 8 bytes
+// #   HEADER  : tag | u64 now | u32 line | u8 level | u8 length | function bytes
+// #   SPAN    : tag | u64 ticks | u32 tid | u8 length | name bytes, right after the header
+// # - the consumer renders a record as text, newline delimited JSON, a length prefixed binary record
+//     or an RFC 5424 syslog message (for syslog collectors behind a socket sink).
+
+enum class FLogTag : std::uint8_t{
+  STR = 1,
+  U32,
+  I32,
+  F64,
+  KEY,
+  HEADER,
+  SPAN
+};
+
+enum class FLogOutputFormat : std::uint8_t{
+  TEXT,
+  JSON,
+  BINARY,
+  RFC5424
+};
+
+inline FLogOutputFormat FLogOutputFormatFrom(const std::string& p_Format) noexcept{
+
+    return (p_Format == "json" ? FLogOutputFormat::JSON :
+            p_Format == "binary" ? FLogOutputFormat::BINARY :
+            p_Format == "rfc5424" ? FLogOutputFormat::RFC5424 : FLogOutputFormat::TEXT);
+}
+
+inline const char* FLogLevelName(LEVEL p_Level) noexcept{
+
+    return (p_Level == LEVEL::INFO ? "INFO" :
+            p_Level == LEVEL::WARN ? "WARN" : "CRIT");
+}
+
+class FLogRecordWriter{
+
+public:
+    FLogRecordWriter(std::uint8_t* p_Buffer, std::size_t p_Capacity, std::size_t p_Used = 0) noexcept
+        :mBuffer(p_Buffer), mCapacity(p_Capacity), mUsed(p_Used){ }
+
+    // Items which do not fit the slot are dropped, strings are truncated.
+    bool Put(const flog_item_type& p_Item) noexcept{
+
+        return std::visit([this](auto&& arg) -> bool {
+
+            using ArgT = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<ArgT, const char*>){
+                return arg ? PutString(FLogTag::STR, arg, strlen(arg)) : true;
+            }else if constexpr (std::is_same_v<ArgT, unsigned int>){
+                return PutScalar(FLogTag::U32, arg);
+            }else if constexpr (std::is_same_v<ArgT, int>){
+                return PutScalar(FLogTag::I32, arg);
+            }else if constexpr (std::is_same_v<ArgT, double>){
+                return PutScalar(FLogTag::F64, arg);
+            }else if constexpr (std::is_same_v<ArgT, FLogKey>){
+                return PutString(FLogTag::KEY, arg.name, strlen(arg.name));
+            }else if constexpr (std::is_same_v<ArgT, FLogHeader>){
+                constexpr std::size_t fixed = 1 + sizeof(arg.now) + sizeof(arg.line) + 1;
+                if (Left() < fixed + 1) return false;
+                mBuffer[mUsed++] = static_cast<std::uint8_t>(FLogTag::HEADER);
+                std::memcpy(mBuffer + mUsed, &arg.now, sizeof(arg.now));     mUsed += sizeof(arg.now);
+                std::memcpy(mBuffer + mUsed, &arg.line, sizeof(arg.line));   mUsed += sizeof(arg.line);
+                mBuffer[mUsed++] = static_cast<std::uint8_t>(arg.level);
+                return PutBytes(arg.function, arg.function ? strlen(arg.function) : 0);
+            }else if constexpr (std::is_same_v<ArgT, FLogSpan>){
+                constexpr std::size_t fixed = 1 + sizeof(arg.ticks) + sizeof(arg.tid);
+                if (Left() < fixed + 1) return false;
+                mBuffer[mUsed++] = static_cast<std::uint8_t>(FLogTag::SPAN);
+                std::memcpy(mBuffer + mUsed, &arg.ticks, sizeof(arg.ticks)); mUsed += sizeof(arg.ticks);
+                std::memcpy(mBuffer + mUsed, &arg.tid, sizeof(arg.tid));     mUsed += sizeof(arg.tid);
+                return PutBytes(arg.name, strlen(arg.name));
+            }else{
+                static_assert(always_false_v<ArgT>, "unsupported type");
+            }
+        }, p_Item);
+    }
+
+    std::size_t Length() const noexcept{ return mUsed; }
+
+    void Reset() noexcept{ mUsed = 0; }
+
+private:
+    std::size_t Left() const noexcept{ return mCapacity - mUsed; }
+
+    template<typename T>
+    bool PutScalar(FLogTag p_Tag, T p_Value) noexcept{
+
+        if (Left() < 1 + sizeof(T)) return false;
+        mBuffer[mUsed++] = static_cast<std::uint8_t>(p_Tag);
+        std::memcpy(mBuffer + mUsed, &p_Value, sizeof(T));
+        mUsed += sizeof(T);
+        return true;
+    }
+
+    bool PutString(FLogTag p_Tag, const char* p_Str, std::size_t p_Length) noexcept{
+
+        if (Left() < 2) return false;
+        mBuffer[mUsed++] = static_cast<std::uint8_t>(p_Tag);
+        return PutBytes(p_Str, p_Length);
+    }
+
+    bool PutBytes(const char* p_Str, std::size_t p_Length) noexcept{
+
+        const std::size_t length = std::min({p_Length, Left() - 1, std::size_t(UINT8_MAX)});
+        mBuffer[mUsed++] = static_cast<std::uint8_t>(length);
+        std::memcpy(mBuffer + mUsed, p_Str, length);
+        mUsed += length;
+        return length == p_Length;
+    }
+
+    std::uint8_t* const mBuffer;
+    const std::size_t mCapacity;
+    std::size_t mUsed;
+};
+
+struct FLogItem{
+    FLogTag tag;
+    std::string_view str;           // STR, KEY, HEADER function and SPAN name
+    std::uint32_t u32{0};           // U32 and SPAN thread id
+    std::int32_t i32{0};
+    double f64{0};
+    std::uint64_t now{0};
+    std::uint32_t line{0};
+    LEVEL level{LEVEL::INFO};
+    std::uint64_t ticks{0};
+};
+
+class FLogRecordReader{
+
+public:
+    FLogRecordReader(const std::uint8_t* p_Record, std::size_t p_Length) noexcept
+        :mRecord(p_Record), mLength(p_Length){ }
+
+    bool Next(FLogItem& p_Item) noexcept{
+
+        if (mPos >= mLength) return false;
+        p_Item.tag = static_cast<FLogTag>(mRecord[mPos++]);
+        switch (p_Item.tag){
+        case FLogTag::STR:
+        case FLogTag::KEY:    return GetString(p_Item.str);
+        case FLogTag::U32:    return Get(p_Item.u32);
+        case FLogTag::I32:    return Get(p_Item.i32);
+        case FLogTag::F64:    return Get(p_Item.f64);
+        case FLogTag::HEADER:{
+            std::uint8_t level = 0;
+            bool ok = Get(p_Item.now) && Get(p_Item.line) && Get(level) && GetString(p_Item.str);
+            p_Item.level = static_cast<LEVEL>(level);
+            return ok;
+        }
+        case FLogTag::SPAN:   return Get(p_Item.ticks) && Get(p_Item.u32) && GetString(p_Item.str);
+        }
+        return false;
+    }
+
+private:
+    template<typename T>
+    bool Get(T& p_Value) noexcept{
+
+        if (mLength - mPos < sizeof(T)) return false;
+        std::memcpy(&p_Value, mRecord + mPos, sizeof(T));
+        mPos += sizeof(T);
+        return true;
+    }
+
+    bool GetString(std::string_view& p_Str) noexcept{
+
+        std::uint8_t length = 0;
+        if (!Get(length) || mLength - mPos < length) return false;
+        p_Str = std::string_view(reinterpret_cast<const char*>(mRecord + mPos), length);
+        mPos += length;
+        return true;
+    }
+
+    const std::uint8_t* const mRecord;
+    const std::size_t mLength;
+    std::size_t mPos{0};
+};
+
+// pushed by WarmUp()/PrepareThread(): every consumer (and flashlogd) drops it unwritten.
+inline bool FLogIsWarmUpRecord(const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+    FLogRecordReader reader(p_Record, p_Length);
+    FLogItem header;
+    return reader.Next(header) && header.tag == FLogTag::HEADER && header.line == FLOG_WARM_UP_LINE;
+}
+
+// Escapes p_In as JSON string content. 16 bytes per step with SSE2, clean runs are copied as is.
+inline char* FLogJsonEscape(char* p_Out, const char* p_In, std::size_t p_Length) noexcept{
+
+    static constexpr char hex[] = "0123456789abcdef";
+    auto escape = [](char* out, unsigned char c) -> char* {
+        *out++ = '\\';
+        switch (c){
+        case '"':  *out++ = '"';  break;
+        case '\\': *out++ = '\\'; break;
+        case '\n': *out++ = 'n';  break;
+        case '\r': *out++ = 'r';  break;
+        case '\t': *out++ = 't';  break;
+        default:
+            *out++ = 'u'; *out++ = '0'; *out++ = '0';
+            *out++ = hex[c >> 4]; *out++ = hex[c & 0xF];
+        }
+        return out;
+    };
+
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (i + 16 <= p_Length){
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_In + i));
+        const __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(v, control), v);
+        const __m128i needsEscape = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                              _mm_cmpeq_epi8(v, backslash)), isControl);
+        const int mask = _mm_movemask_epi8(needsEscape);
+        if (mask == 0){
+            std::memcpy(p_Out, p_In + i, 16);
+            p_Out += 16; i += 16;
+            continue;
+        }
+        const int clean = __builtin_ctz(mask);
+        std::memcpy(p_Out, p_In + i, clean);
+        p_Out = escape(p_Out + clean, static_cast<unsigned char>(p_In[i + clean]));
+        i += clean + 1;
+    }
+#endif
+    for (; i < p_Length; ++i){
+        const unsigned char c = static_cast<unsigned char>(p_In[i]);
+        if (c == '"' || c == '\\' || c < 0x20){
+            p_Out = escape(p_Out, c);
+        }else{
+            *p_Out++ = static_cast<char>(c);
+        }
+    }
+    return p_Out;
+}
+
+class FLogRecordRenderer{
+
+public:
+    // worst case: a full slot of control characters escaped as \u00XX plus the header.
+    static constexpr std::size_t MAX_RENDERED_SIZE{4096};
+    // one item and the trailer: a string of a 256-byte slot escaped, or a double in fixed notation (~320).
+    // a slot of doubles outgrows the buffer, items past the limit are dropped and the line ends with "...".
+    static constexpr std::size_t MAX_ITEM_SIZE{6 * 256 + 64};
+    static constexpr std::uint8_t BINARY_MAGIC{0xF1};
+
+    // p_SignalSafe: never call localtime, the time is printed as epoch seconds instead.
+    explicit FLogRecordRenderer(FLogOutputFormat p_Format = FLogOutputFormat::TEXT, bool p_SignalSafe = false) noexcept
+        :mFormat(p_Format), mSignalSafe(p_SignalSafe){
+
+        if (mFormat == FLogOutputFormat::RFC5424){
+            if (gethostname(mHost, sizeof(mHost) - 1) != 0 || !mHost[0]) std::strcpy(mHost, "-");
+            std::strncpy(mApp, program_invocation_short_name, sizeof(mApp) - 1);
+            if (!mApp[0]) std::strcpy(mApp, "-");
+            for (char* c : {mHost, mApp}){
+                for (; *c; ++c) if (*c <= ' ' || *c > '~') *c = '_';
+            }
+        }
+    }
+
+    FLogOutputFormat Format() const noexcept{ return mFormat; }
+
+    // No allocation, the rendered bytes stay valid until the next call.
+    std::size_t Render(const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+        char* out = mOut;
+        switch (mFormat){
+        case FLogOutputFormat::TEXT:   out = RenderText(out, p_Record, p_Length); break;
+        case FLogOutputFormat::JSON:   out = RenderJson(out, p_Record, p_Length); break;
+        case FLogOutputFormat::BINARY: out = RenderBinary(out, p_Record, p_Length); break;
+        case FLogOutputFormat::RFC5424: out = RenderSyslog(out, p_Record, p_Length); break;
+        }
+        return out - mOut;
+    }
+
+    const std::uint8_t* Data() const noexcept{ return reinterpret_cast<const std::uint8_t*>(mOut); }
+
+private:
+    bool Full(const char* p_Out) const noexcept{ return p_Out > mOut + MAX_RENDERED_SIZE - MAX_ITEM_SIZE; }
+
+    static char* Append(char* p_Out, std::string_view p_Str) noexcept{
+
+        std::memcpy(p_Out, p_Str.data(), p_Str.size());
+        return p_Out + p_Str.size();
+    }
+
+    // same layout as std::to_string
+    static char* AppendNumber(char* p_Out, const FLogItem& p_Item) noexcept{
+
+        switch (p_Item.tag){
+        case FLogTag::U32: return std::to_chars(p_Out, p_Out + 16, p_Item.u32).ptr;
+        case FLogTag::I32: return std::to_chars(p_Out, p_Out + 16, p_Item.i32).ptr;
+        case FLogTag::F64:{
+            auto res = std::to_chars(p_Out, p_Out + 512, p_Item.f64, std::chars_format::fixed, 6);
+            return res.ec == std::errc() ? res.ptr : Append(p_Out, "nan");
+        }
+        default: return p_Out;
+        }
+    }
+
+    char* AppendTime(char* p_Out, std::uint64_t p_Now) noexcept{
+
+        // localtime is paid once per second, not once per line.
+        const std::time_t seconds = static_cast<std::time_t>(p_Now / 1000000);
+        if (mSignalSafe){
+            p_Out = Append(p_Out, "epoch: ");
+            p_Out = std::to_chars(p_Out, p_Out + 24, seconds).ptr;
+        }else{
+            if (seconds != mCachedSecond){
+                std::tm tm{};
+                localtime_r(&seconds, &tm);
+                mCachedTimeLength = std::strftime(mCachedTime, sizeof(mCachedTime), "%c", &tm);
+                mCachedSecond = seconds;
+            }
+            p_Out = Append(p_Out, std::string_view(mCachedTime, mCachedTimeLength));
+        }
+        p_Out = Append(p_Out, " micro-seconds: ");
+        return std::to_chars(p_Out, p_Out + 16, p_Now % 1000000).ptr;
+    }
+
+    // everything but the header, as in a text line.
+    static char* AppendTextItem(char* p_Out, const FLogItem& p_Item) noexcept{
+
+        switch (p_Item.tag){
+        case FLogTag::KEY:
+            *p_Out++ = ' ';
+            p_Out = Append(p_Out, p_Item.str);
+            *p_Out++ = '=';
+            return p_Out;
+        case FLogTag::STR:
+            return Append(p_Out, p_Item.str);
+        case FLogTag::SPAN:
+            p_Out = Append(p_Out, " span=");
+            p_Out = Append(p_Out, p_Item.str);
+            p_Out = Append(p_Out, " ns=");
+            p_Out = std::to_chars(p_Out, p_Out + 24, static_cast<std::uint64_t>(FLogTickClock::ToNanos(p_Item.ticks))).ptr;
+            p_Out = Append(p_Out, " tid=");
+            return std::to_chars(p_Out, p_Out + 16, p_Item.u32).ptr;
+        default:
+            return AppendNumber(p_Out, p_Item);
+        }
+    }
+
+    char* RenderText(char* p_Out, const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+        FLogRecordReader reader(p_Record, p_Length);
+        FLogItem item;
+        while (reader.Next(item)){
+            switch (item.tag){
+            case FLogTag::HEADER:
+                p_Out = Append(p_Out, "[ ");
+                p_Out = AppendTime(p_Out, item.now);
+                p_Out = Append(p_Out, " ][ ");
+                p_Out = Append(p_Out, item.str);
+                p_Out = Append(p_Out, " : ");
+                p_Out = std::to_chars(p_Out, p_Out + 16, item.line).ptr;
+                p_Out = Append(p_Out, " ]");
+                break;
+            default:
+                if (Full(p_Out)) return Append(p_Out, "... \n");
+                p_Out = AppendTextItem(p_Out, item);
+            }
+        }
+        return Append(p_Out, " \n");
+    }
+
+    char* RenderJson(char* p_Out, const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+        // pass 1: header and free text as "msg", pass 2: key/value fields.
+        *p_Out++ = '{';
+        FLogRecordReader reader(p_Record, p_Length);
+        FLogItem item;
+        bool isValue = false;
+        bool truncated = false;
+        char* msg = nullptr;
+        while (reader.Next(item)){
+            if (item.tag == FLogTag::HEADER){
+                // a span is a Chrome trace "complete" event: ts is its start, not its end.
+                FLogRecordReader peek = reader;
+                FLogItem span;
+                const bool isSpan = peek.Next(span) && span.tag == FLogTag::SPAN;
+                const std::uint64_t micros = isSpan ? static_cast<std::uint64_t>(FLogTickClock::ToNanos(span.ticks) / 1000) : 0;
+                p_Out = Append(p_Out, "\"ts\":");
+                p_Out = std::to_chars(p_Out, p_Out + 24, item.now - std::min(micros, item.now)).ptr;
+                p_Out = Append(p_Out, ",\"level\":\"");
+                p_Out = Append(p_Out, FLogLevelName(item.level));
+                p_Out = Append(p_Out, "\",\"func\":\"");
+                p_Out = FLogJsonEscape(p_Out, item.str.data(), item.str.size());
+                p_Out = Append(p_Out, "\",\"line\":");
+                p_Out = std::to_chars(p_Out, p_Out + 16, item.line).ptr;
+                *p_Out++ = ',';
+                continue;
+            }
+            if (item.tag == FLogTag::SPAN){
+                p_Out = Append(p_Out, "\"name\":\"");
+                p_Out = FLogJsonEscape(p_Out, item.str.data(), item.str.size());
+                p_Out = Append(p_Out, "\",\"ph\":\"X\",\"dur\":");
+                p_Out = std::to_chars(p_Out, p_Out + 32, FLogTickClock::ToNanos(item.ticks) / 1000, std::chars_format::fixed, 3).ptr;
+                p_Out = Append(p_Out, ",\"pid\":");
+                p_Out = std::to_chars(p_Out, p_Out + 16, mPid).ptr;
+                p_Out = Append(p_Out, ",\"tid\":");
+                p_Out = std::to_chars(p_Out, p_Out + 16, item.u32).ptr;
+                *p_Out++ = ',';
+                continue;
+            }
+            if (item.tag == FLogTag::KEY){
+                isValue = true;
+                continue;
+            }
+            if (isValue){
+                isValue = false;
+                continue;
+            }
+            if (Full(p_Out)){
+                if (msg && !truncated) p_Out = Append(p_Out, "...");
+                truncated = true;
+                continue;
+            }
+            if (!msg){
+                p_Out = msg = Append(p_Out, "\"msg\":\"");
+            }
+            p_Out = (item.tag == FLogTag::STR) ? FLogJsonEscape(p_Out, item.str.data(), item.str.size())
+                                               : AppendNumber(p_Out, item);
+        }
+        if (msg){
+            p_Out = Append(p_Out, "\",");
+        }
+
+        FLogRecordReader fields(p_Record, p_Length);
+        while (fields.Next(item)){
+            if (item.tag != FLogTag::KEY) continue;
+            if (Full(p_Out)){
+                truncated = true;
+                break;
+            }
+            *p_Out++ = '"';
+            p_Out = FLogJsonEscape(p_Out, item.str.data(), item.str.size());
+            p_Out = Append(p_Out, "\":");
+            if (!fields.Next(item)){
+                p_Out = Append(p_Out, "null");
+            }else if (item.tag == FLogTag::STR){
+                *p_Out++ = '"';
+                p_Out = FLogJsonEscape(p_Out, item.str.data(), item.str.size());
+                *p_Out++ = '"';
+            }else if (item.tag == FLogTag::F64){
+                auto res = std::to_chars(p_Out, p_Out + 32, item.f64);
+                p_Out = (res.ec == std::errc() && std::isfinite(item.f64)) ? res.ptr : Append(p_Out, "null");
+            }else{
+                p_Out = AppendNumber(p_Out, item);
+            }
+            *p_Out++ = ',';
+        }
+        if (truncated) p_Out = Append(p_Out, "\"truncated\":true,");
+        if (*(p_Out - 1) == ',') --p_Out;
+        return Append(p_Out, "}\n");
+    }
+
+    // "<PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID - [flog func line] MSG", facility user.
+    // the UTC time is computed, no gmtime: the crash renderer runs in a signal handler.
+    char* RenderSyslog(char* p_Out, const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+        FLogRecordReader reader(p_Record, p_Length);
+        FLogItem item;
+        if (reader.Next(item) && item.tag == FLogTag::HEADER){
+            const unsigned severity = (item.level == LEVEL::INFO ? 6 : item.level == LEVEL::WARN ? 4 : 2);
+            *p_Out++ = '<';
+            p_Out = std::to_chars(p_Out, p_Out + 4, 8 + severity).ptr;
+            p_Out = Append(p_Out, ">1 ");
+            p_Out = AppendUtc(p_Out, item.now);
+            *p_Out++ = ' ';
+            p_Out = Append(p_Out, mHost);
+            *p_Out++ = ' ';
+            p_Out = Append(p_Out, mApp);
+            *p_Out++ = ' ';
+            p_Out = std::to_chars(p_Out, p_Out + 16, mPid).ptr;
+            p_Out = Append(p_Out, " - [flog@32473 func=\"");
+            for (const char c : item.str){
+                if (c == '"' || c == '\\' || c == ']') *p_Out++ = '\\';
+                *p_Out++ = c;
+            }
+            p_Out = Append(p_Out, "\" line=\"");
+            p_Out = std::to_chars(p_Out, p_Out + 16, item.line).ptr;
+            p_Out = Append(p_Out, "\"] ");
+        }else{
+            p_Out = Append(p_Out, "<14>1 - - - - - - ");
+            if (item.tag != FLogTag::HEADER) p_Out = AppendTextItem(p_Out, item);
+        }
+        while (reader.Next(item)){
+            if (Full(p_Out)){
+                p_Out = Append(p_Out, "...");
+                break;
+            }
+            p_Out = AppendTextItem(p_Out, item);
+        }
+        *p_Out++ = '\n';
+        return p_Out;
+    }
+
+    // 2026-10-19T11:41:35.095587Z
+    static char* AppendUtc(char* p_Out, std::uint64_t p_Now) noexcept{
+
+        const std::int64_t seconds = static_cast<std::int64_t>(p_Now / 1000000);
+        std::int64_t days = seconds / 86400;
+        const unsigned daySeconds = static_cast<unsigned>(seconds % 86400);
+        // days since 1970-01-01 to y/m/d, H. Hinnant's civil_from_days.
+        days += 719468;
+        const std::int64_t era = days / 146097;
+        const unsigned doe = static_cast<unsigned>(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+        const std::int64_t year = static_cast<std::int64_t>(yoe) + era * 400 + (month <= 2);
+
+        auto two = [&p_Out](unsigned p_Value, char p_Separator){
+            *p_Out++ = static_cast<char>('0' + p_Value / 10);
+            *p_Out++ = static_cast<char>('0' + p_Value % 10);
+            *p_Out++ = p_Separator;
+        };
+        p_Out = std::to_chars(p_Out, p_Out + 8, year).ptr;
+        *p_Out++ = '-';
+        two(month, '-');
+        two(day, 'T');
+        two(daySeconds / 3600, ':');
+        two(daySeconds / 60 % 60, ':');
+        two(daySeconds % 60, '.');
+        char micros[8];
+        const auto end = std::to_chars(micros, micros + sizeof(micros), p_Now % 1000000).ptr;
+        for (auto digits = end - micros; digits < 6; ++digits) *p_Out++ = '0';
+        p_Out = Append(p_Out, std::string_view(micros, end - micros));
+        *p_Out++ = 'Z';
+        return p_Out;
+    }
+
+    char* RenderBinary(char* p_Out, const std::uint8_t* p_Record, std::size_t p_Length) noexcept{
+
+        const std::uint16_t length = static_cast<std::uint16_t>(p_Length);
+        *p_Out++ = static_cast<char>(BINARY_MAGIC);
+        std::memcpy(p_Out, &length, sizeof(length));
+        std::memcpy(p_Out + sizeof(length), p_Record, length);
+        return p_Out + sizeof(length) + length;
+    }
+
+    const FLogOutputFormat mFormat;
+    const bool mSignalSafe;
+    const int mPid{getpid()};
+    char mOut[MAX_RENDERED_SIZE];
+    std::time_t mCachedSecond{-1};
+    char mCachedTime[64];
+    std::size_t mCachedTimeLength{0};
+    char mHost[64]{};
+    char mApp[48]{};
+};
+
+#endif /* FLOG_RECORD_HPP */
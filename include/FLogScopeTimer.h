@@ -0,0 +1,72 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_SCOPE_TIMER_HPP
+#define FLOG_SCOPE_TIMER_HPP
+
+#include <cstdint>
+
+#include "FLogUtilStructs.h"
+#include "FLogTrace.h"
+
+// apart from FLogTrace.h: the timer goes through FLogManager, readers of the ring
+// (flashlogd) include the clock and the span table only.
+class FLogManager;
+FLOG_EXTERNAL bool FLogTraceEnabledExternal() noexcept;
+FLOG_EXTERNAL void FLogTraceSpanExternal(const char* p_Name, std::uint64_t p_Start, const char* p_Function, std::uint32_t p_Line);
+
+// FLOG_SCOPE_TIMER("decode"); times the rest of the enclosing scope.
+// FLOG_TRACE_SPAN(span, "send"); ... span.End(); for a part of a scope. p_Name must be a literal.
+class FLogScopeTimer{
+
+public:
+    FLogScopeTimer(const char* p_Name, const char* p_Function, std::uint32_t p_Line) noexcept
+        :mName(p_Name), mFunction(p_Function), mLine(p_Line),
+         mStart(FLogTraceEnabledExternal() ? FLogTickClock::Now() : 0){ }
+
+    FLogScopeTimer(const FLogScopeTimer&) = delete;
+    FLogScopeTimer& operator=(const FLogScopeTimer&) = delete;
+
+    ~FLogScopeTimer(){ End(); }
+
+    void End(){
+
+        if (!mStart) return;
+        FLogTraceSpanExternal(mName, mStart, mFunction, mLine);
+        mStart = 0;
+    }
+
+private:
+    const char* mName;
+    const char* mFunction;
+    std::uint32_t mLine;
+    std::uint64_t mStart;
+};
+
+#define FLOG_TRACE_CONCAT_(a, b) a##b
+#define FLOG_TRACE_CONCAT(a, b) FLOG_TRACE_CONCAT_(a, b)
+#define FLOG_TRACE_SPAN(p_Var, p_Name) FLogScopeTimer p_Var(p_Name, __FUNCTION__, __LINE__)
+#define FLOG_SCOPE_TIMER(p_Name) FLOG_TRACE_SPAN(FLOG_TRACE_CONCAT(flogScopeTimer, __LINE__), p_Name)
+
+#endif /* FLOG_SCOPE_TIMER_HPP */
@@ -0,0 +1,234 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_SITE_PROFILER_HPP
+#define FLOG_SITE_PROFILER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FLogTrace.h"
+
+// Design note:
+// # - a call site is its function and line, as passed to getFlogLine.
+// # - the logging thread counts calls, drops (filtered by level or limiter) and the ticks spent
+//     from getFlogLine to the end of the line, in a table of its own: no sharing, no lock.
+// # - the consumer counts written lines and rendered bytes per site in the logger's table.
+// # - tables are single writer, counters relaxed atomics: the report reads them live and joins
+//     both sides by function name and line.
+// # - a thread table is kept after the thread exits, its counts stay in the report.
+
+struct FLogSiteEntry{
+    std::atomic<std::uint64_t> key{0};     // 0: free
+    char function[64];
+    std::uint32_t line{0};
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> drops{0};
+    std::atomic<std::uint64_t> ticks{0};
+    std::atomic<std::uint64_t> lines{0};
+    std::atomic<std::uint64_t> bytes{0};
+
+    static void Add(std::atomic<std::uint64_t>& p_Counter, std::uint64_t p_Value) noexcept{
+
+        // single writer: no locked instruction.
+        p_Counter.store(p_Counter.load(std::memory_order_relaxed) + p_Value, std::memory_order_relaxed);
+    }
+};
+
+// open addressing, fixed size: a site beyond the capacity is not profiled.
+class FLogSiteTable{
+
+public:
+    static constexpr std::size_t CAPACITY = 512;
+
+    FLogSiteEntry* Get(std::uint64_t p_Key, std::string_view p_Function, std::uint32_t p_Line) noexcept{
+
+        p_Key |= 1;
+        for (std::size_t i = 0, slot = p_Key % CAPACITY; i < CAPACITY; ++i, slot = (slot + 1) % CAPACITY){
+            FLogSiteEntry& entry = mEntries[slot];
+            const std::uint64_t key = entry.key.load(std::memory_order_relaxed);
+            if (key == p_Key && entry.line == p_Line) return &entry;
+            if (key == 0){
+                const std::size_t length = std::min(p_Function.size(), sizeof(entry.function) - 1);
+                std::memcpy(entry.function, p_Function.data(), length);
+                entry.function[length] = '\0';
+                entry.line = p_Line;
+                entry.key.store(p_Key, std::memory_order_release);
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename F>
+    void ForEach(F&& p_Visit) const{
+
+        for (const auto& entry : mEntries){
+            if (entry.key.load(std::memory_order_acquire) != 0) p_Visit(entry);
+        }
+    }
+
+private:
+    FLogSiteEntry mEntries[CAPACITY];
+};
+
+struct FLogSiteReport{
+    std::string function;
+    std::uint32_t line{0};
+    std::uint64_t lines{0};        // written by the consumer
+    std::uint64_t bytes{0};        // rendered
+    std::uint64_t drops{0};        // filtered by level or limiter
+    double nanosPerCall{0};        // getFlogLine to the end of the line, on the logging thread
+};
+
+class FLogSiteProfiler{
+
+public:
+    // logging thread, from getFlogLine. p_Written: the line goes to the sink.
+    static void Begin(const char* p_Function, std::uint32_t p_Line, bool p_Written, std::uint64_t p_Start) noexcept{
+
+        FLogSiteEntry* site = ThreadTable().Get(reinterpret_cast<std::uintptr_t>(p_Function) * 31 + p_Line,
+                                                p_Function ? p_Function : "", p_Line);
+        if (!site) return;
+        if (!p_Written){
+            FLogSiteEntry::Add(site->drops, 1);
+            return;
+        }
+        FLogSiteEntry::Add(site->calls, 1);
+        sPending = Pending{site, p_Start};
+    }
+
+    // logging thread, end of the line.
+    static void End() noexcept{
+
+        Pending& pending = sPending;
+        if (!pending.site) return;
+        FLogSiteEntry::Add(pending.site->ticks, FLogTickClock::Now() - pending.start);
+        pending.site = nullptr;
+    }
+
+    // logging thread, ahead of its first profiled line: the table is allocated and registered here.
+    static void PrepareThread(){
+
+        ThreadTable();
+    }
+
+    // consumer thread of one logger.
+    static void Written(FLogSiteTable& p_Table, std::string_view p_Function, std::uint32_t p_Line, std::size_t p_Bytes) noexcept{
+
+        std::uint64_t key = 0xcbf29ce484222325ULL;
+        for (const char c : p_Function) key = (key ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+        if (FLogSiteEntry* site = p_Table.Get(key, p_Function, p_Line)){
+            FLogSiteEntry::Add(site->lines, 1);
+            FLogSiteEntry::Add(site->bytes, p_Bytes);
+        }
+    }
+
+    // p_Consumers: the tables of every logger. noisiest first by bytes, then by drops.
+    static std::vector<FLogSiteReport> Report(const std::vector<const FLogSiteTable*>& p_Consumers, std::size_t p_Top){
+
+        std::map<std::pair<std::string, std::uint32_t>, FLogSiteReport> sites;
+        std::map<std::pair<std::string, std::uint32_t>, std::pair<std::uint64_t, std::uint64_t>> timing;
+        auto site = [&sites](const FLogSiteEntry& p_Entry) -> FLogSiteReport& {
+            FLogSiteReport& report = sites[{p_Entry.function, p_Entry.line}];
+            report.function = p_Entry.function;
+            report.line = p_Entry.line;
+            return report;
+        };
+        {
+            std::lock_guard<std::mutex> lock(TablesMutex());
+            for (const auto& table : Tables()){
+                table->ForEach([&](const FLogSiteEntry& p_Entry){
+                    site(p_Entry).drops += p_Entry.drops.load(std::memory_order_relaxed);
+                    auto& time = timing[{p_Entry.function, p_Entry.line}];
+                    time.first += p_Entry.calls.load(std::memory_order_relaxed);
+                    time.second += p_Entry.ticks.load(std::memory_order_relaxed);
+                });
+            }
+        }
+        for (const auto* table : p_Consumers){
+            table->ForEach([&](const FLogSiteEntry& p_Entry){
+                FLogSiteReport& report = site(p_Entry);
+                report.lines += p_Entry.lines.load(std::memory_order_relaxed);
+                report.bytes += p_Entry.bytes.load(std::memory_order_relaxed);
+            });
+        }
+
+        std::vector<FLogSiteReport> ranked;
+        ranked.reserve(sites.size());
+        for (auto& [key, report] : sites){
+            const auto& time = timing[key];
+            report.nanosPerCall = time.first ? FLogTickClock::ToNanos(time.second) / time.first : 0;
+            ranked.push_back(std::move(report));
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const FLogSiteReport& a, const FLogSiteReport& b){
+            return a.bytes != b.bytes ? a.bytes > b.bytes : a.drops > b.drops;
+        });
+        if (ranked.size() > p_Top) ranked.resize(p_Top);
+        return ranked;
+    }
+
+private:
+    struct Pending{
+        FLogSiteEntry* site;
+        std::uint64_t start;
+    };
+
+    static FLogSiteTable& ThreadTable(){
+
+        FLogSiteTable* table = sThreadTable;
+        if (!table){
+            table = sThreadTable = new FLogSiteTable();
+            std::lock_guard<std::mutex> lock(TablesMutex());
+            Tables().push_back(table);
+        }
+        return *table;
+    }
+
+    // never destroyed: the global logger reports from its destructor, after other statics.
+    static std::vector<FLogSiteTable*>& Tables(){
+
+        static auto* s_Tables = new std::vector<FLogSiteTable*>();
+        return *s_Tables;
+    }
+
+    static std::mutex& TablesMutex(){
+
+        static auto* s_Mutex = new std::mutex();
+        return *s_Mutex;
+    }
+
+    // trivial thread locals, no init guard on the log path.
+    static inline thread_local FLogSiteTable* sThreadTable;
+    static inline thread_local Pending sPending;
+};
+
+#endif /* FLOG_SITE_PROFILER_HPP */
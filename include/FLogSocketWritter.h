@@ -0,0 +1,297 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "FLogRateLimit.h"
+
+// Design note:
+// # - endpoints: "unix:<path>" (datagram), "unix-stream:<path>" and "udp:<host>:<port>".
+// # - WriteToFile() only copies the rendered record into the queue. the queue goes out with
+//     one sendmmsg (datagrams, one record per message) or one sendmsg (stream, a writev which
+//     cannot raise SIGPIPE; records are newline framed) per BATCH_RECORDS records, when
+//     BATCH_BYTES are queued, on Flush() and whenever the ring runs empty (Idle()).
+// # - the socket is non-blocking, what the kernel does not take stays queued for the next
+//     send. the queue is bounded (FlashLogger.socket_queue_kb): beyond it records are dropped
+//     and counted, the consumer never waits for a slow receiver.
+// # - no receiver yet, or a lost one: reconnect at most once a second, records queue meanwhile.
+// # - RFC 5424 framing is a render format (output_format = rfc5424), this sink moves bytes.
+class FLogSocketWritter
+{
+public:
+    static constexpr std::size_t BATCH_RECORDS{64};
+    static constexpr std::size_t BATCH_BYTES{64 * 1024};
+    static constexpr const char* NAME{"socket"};
+
+    template<typename CONFIG>
+    static auto ConfigArgs(const CONFIG& p_Data){
+
+        return std::make_tuple(p_Data.socket_endpoint, std::size_t{p_Data.socket_queue_kb} * 1024);
+    }
+
+    explicit FLogSocketWritter(const std::string& p_Endpoint, std::size_t p_QueueBytes = 1 << 20)
+        :mQueueBytes(std::max(p_QueueBytes, BATCH_BYTES)){
+
+        Resolve(p_Endpoint);
+        Connect();
+    }
+
+    FLogSocketWritter(const FLogSocketWritter&) = delete;
+    FLogSocketWritter& operator=(const FLogSocketWritter&) = delete;
+
+    ~FLogSocketWritter(){
+
+        Send();
+        Disconnect();
+    }
+
+    bool WriteToFile(const std::uint8_t* data, int size) {
+
+        // a datagram is its own frame.
+        if (mDatagram && size > 0 && data[size - 1] == '\n') --size;
+        if (size <= 0) return true;
+        if (Queued() + size <= mQueueBytes){
+            mRecords.emplace_back(mBytes.size(), static_cast<std::uint32_t>(size));
+            mBytes.append(reinterpret_cast<const char*>(data), size);
+            mBatchBytes += size;
+        }else{
+            ++mDropped;
+        }
+        // a blocked receiver is retried once a batch too, not once a record.
+        if (++mBatchRecords >= BATCH_RECORDS || mBatchBytes >= BATCH_BYTES){
+            Send();
+        }
+        return true;
+    }
+
+    // true once every queued record is with the kernel.
+    bool Flush() {
+
+        return Send();
+    }
+
+    // the consumer found the ring empty: nothing more to batch with. a blocked receiver is
+    // retried at the coarse clock's pace, not every time the consumer polls.
+    void Idle() {
+
+        if (mHead == mRecords.size()) return;
+        if (mBlockedSince && FLogCoarseNanos() == mBlockedSince) return;
+        Send();
+    }
+
+    // no file, nothing to index.
+    std::uint64_t Offset() const noexcept{
+
+        return 0;
+    }
+
+    // nothing to fdatasync.
+    int Fd() const noexcept{
+
+        return -1;
+    }
+
+    // Fatal signal path: what the kernel takes of the queue, then the caller write(2)s the
+    // ring to the socket, blocking. without a connection the lines go to stderr.
+    int FlushForCrash() noexcept{
+
+        if (mFd < 0) return STDERR_FILENO;
+        Send();
+        fcntl(mFd, F_SETFL, fcntl(mFd, F_GETFL) & ~O_NONBLOCK);
+        return mFd;
+    }
+
+    std::uint64_t Dropped() const noexcept{ return mDropped; }
+    std::uint64_t Syscalls() const noexcept{ return mSyscalls; }
+
+    std::size_t Queued() const noexcept{
+
+        return mHead == mRecords.size() ? 0 : mBytes.size() - mRecords[mHead].first - mHeadSent;
+    }
+
+private:
+    void Resolve(const std::string& p_Endpoint){
+
+        const auto colon = p_Endpoint.find(':');
+        const std::string scheme = p_Endpoint.substr(0, colon);
+        const std::string rest = (colon == std::string::npos) ? "" : p_Endpoint.substr(colon + 1);
+        if (scheme == "unix" || scheme == "unix-stream"){
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, rest.c_str(), sizeof(addr.sun_path) - 1);
+            std::memcpy(&mAddr, &addr, sizeof(addr));
+            mAddrLength = sizeof(addr);
+            mDatagram = (scheme == "unix");
+            return;
+        }
+        const auto port = rest.rfind(':');
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* found = nullptr;
+        if (scheme == "udp" && port != std::string::npos &&
+            getaddrinfo(rest.substr(0, port).c_str(), rest.substr(port + 1).c_str(), &hints, &found) == 0){
+            std::memcpy(&mAddr, found->ai_addr, found->ai_addrlen);
+            mAddrLength = found->ai_addrlen;
+            freeaddrinfo(found);
+        }
+        mDatagram = true;
+    }
+
+    bool Connect() noexcept{
+
+        if (mFd >= 0) return true;
+        if (!mAddrLength) return false;
+        const std::uint64_t now = FLogCoarseNanos();
+        if (mLastConnect && now - mLastConnect < 1000000000) return false;
+        mLastConnect = now;
+        mFd = socket(mAddr.ss_family, (mDatagram ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (mFd >= 0 && connect(mFd, reinterpret_cast<const sockaddr*>(&mAddr), mAddrLength) != 0){
+            Disconnect();
+        }
+        return mFd >= 0;
+    }
+
+    void Disconnect() noexcept{
+
+        if (mFd >= 0) close(mFd);
+        mFd = -1;
+        // a stream receiver gets the whole record again, never the tail of one.
+        mHeadSent = 0;
+    }
+
+    // true when the queue is empty.
+    bool Send() noexcept{
+
+        mBatchRecords = 0;
+        mBatchBytes = 0;
+        if (mHead == mRecords.size()) return true;
+        if (!Connect()) return false;
+        mBlockedSince = 0;
+        iovec iov[BATCH_RECORDS];
+        while (mHead < mRecords.size()){
+            const std::size_t n = std::min(mRecords.size() - mHead, BATCH_RECORDS);
+            for (std::size_t i = 0; i < n; ++i){
+                const auto& [offset, length] = mRecords[mHead + i];
+                iov[i].iov_base = &mBytes[offset];
+                iov[i].iov_len = length;
+            }
+            ++mSyscalls;
+            if (mDatagram){
+                mmsghdr messages[BATCH_RECORDS];
+                for (std::size_t i = 0; i < n; ++i){
+                    messages[i] = mmsghdr{};
+                    messages[i].msg_hdr.msg_iov = &iov[i];
+                    messages[i].msg_hdr.msg_iovlen = 1;
+                }
+                const int sent = sendmmsg(mFd, messages, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (sent > 0){
+                    mHead += sent;
+                    continue;
+                }
+            }else{
+                iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + mHeadSent;
+                iov[0].iov_len -= mHeadSent;
+                msghdr message{};
+                message.msg_iov = iov;
+                message.msg_iovlen = n;
+                ssize_t sent = sendmsg(mFd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (sent > 0){
+                    for (; sent > 0 && mHead < mRecords.size(); ){
+                        const std::size_t left = mRecords[mHead].second - mHeadSent;
+                        if (static_cast<std::size_t>(sent) < left){
+                            mHeadSent += sent;
+                            break;
+                        }
+                        sent -= left;
+                        mHeadSent = 0;
+                        ++mHead;
+                    }
+                    continue;
+                }
+            }
+            if (errno == EINTR) continue;
+            if (errno == EMSGSIZE){
+                ++mDropped;
+                ++mHead;
+                continue;
+            }
+            // receiver is behind: keep the rest for the next send.
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) mBlockedSince = FLogCoarseNanos();
+            else Disconnect();
+            break;
+        }
+        Compact();
+        return mHead == mRecords.size();
+    }
+
+    void Compact(){
+
+        if (mHead == mRecords.size()){
+            mRecords.clear();
+            mBytes.clear();
+            mHead = 0;
+            return;
+        }
+        if (mHead < BATCH_RECORDS || mHead * 2 < mRecords.size()) return;
+        const std::size_t shift = mRecords[mHead].first;
+        mBytes.erase(0, shift);
+        mRecords.erase(mRecords.begin(), mRecords.begin() + mHead);
+        for (auto& record : mRecords) record.first -= shift;
+        mHead = 0;
+    }
+
+    sockaddr_storage mAddr{};
+    socklen_t mAddrLength{0};
+    bool mDatagram{true};
+    int mFd{-1};
+    std::uint64_t mLastConnect{0};
+    const std::size_t mQueueBytes;
+    // rendered records not yet with the kernel: [mHead, end) of mRecords (offset, length) in mBytes.
+    std::string mBytes;
+    std::vector<std::pair<std::size_t, std::uint32_t>> mRecords;
+    std::size_t mHead{0};
+    std::size_t mHeadSent{0};
+    // appended (or dropped) since the last send.
+    std::size_t mBatchRecords{0};
+    std::size_t mBatchBytes{0};
+    std::uint64_t mBlockedSince{0};
+    std::uint64_t mDropped{0};
+    std::uint64_t mSyscalls{0};
+};
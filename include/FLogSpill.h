@@ -0,0 +1,269 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_SPILL_HPP
+#define FLOG_SPILL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Design note:
+// # - overflow tier of the ring (FlashLogger.spill_file): past the high water mark the consumer
+//     moves committed records, raw, from the ring into this file instead of rendering them, and
+//     writes them back to the sink, oldest first, once the ring is under the low water mark.
+// # - the file is preallocated and mapped: a spill is a memcpy, the kernel writes the pages back
+//     at disk bandwidth (kicked every WRITEBACK_BYTES) and drained ranges leave the page cache.
+// # - same layout as FLogSinkQueue: u32 length | bytes, 8 byte aligned, the tail of the file is
+//     skipped rather than wrapping a record. consumer thread only, the crash handler reads.
+// # - the file is unlinked once mapped: nothing is left behind, records still spilled at a crash
+//     are written from the mapping by the crash handler.
+// # - put it on a local disk: on tmpfs it costs the RAM it was meant to save.
+class FLogSpillFile{
+
+public:
+    static constexpr std::size_t WRITEBACK_BYTES = 4 * 1024 * 1024;
+
+    FLogSpillFile() = default;
+    FLogSpillFile(const FLogSpillFile&) = delete;
+    FLogSpillFile& operator=(const FLogSpillFile&) = delete;
+
+    ~FLogSpillFile(){
+
+        Close();
+    }
+
+    bool Open(const std::string& p_Path, std::size_t p_Bytes){
+
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t capacity = (std::max<std::size_t>(p_Bytes, WRITEBACK_BYTES) + page - 1) / page * page;
+        const int fd = open(p_Path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0) return false;
+        // blocks are reserved now, a full disk shows at start up and not in the middle of a burst.
+        if (posix_fallocate(fd, 0, capacity) != 0){
+            close(fd);
+            unlink(p_Path.c_str());
+            return false;
+        }
+        void* memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        unlink(p_Path.c_str());
+        if (memory == MAP_FAILED){
+            close(fd);
+            return false;
+        }
+        mFd = fd;
+        mCapacity = capacity;
+        mBuffer = static_cast<std::uint8_t*>(memory);
+        return true;
+    }
+
+    bool IsOpen() const noexcept{ return mBuffer != nullptr; }
+
+    bool Empty() const noexcept{
+
+        return mHead.load(std::memory_order_relaxed) == mTail.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t Records() const noexcept{ return mRecords; }      // spilled since start
+    std::uint64_t Full() const noexcept{ return mFull; }            // pushes refused, no room
+    std::uint64_t PeakBytes() const noexcept{ return mPeakBytes; }
+
+    // can a record of p_Size bytes be pushed? ask before taking it out of the ring, a record
+    // the file has no room for stays where it is.
+    bool Room(std::uint32_t p_Size) const noexcept{
+
+        std::size_t index, skip;
+        return Fits(p_Size, index, skip);
+    }
+
+    // false: no room, nothing is written.
+    bool Push(const std::uint8_t* p_Data, std::uint32_t p_Size) noexcept{
+
+        std::size_t index, skip;
+        if (!Fits(p_Size, index, skip)){
+            ++mFull;
+            return false;
+        }
+        const std::uint64_t head = mHead.load(std::memory_order_relaxed);
+        const std::uint64_t tail = mTail.load(std::memory_order_relaxed);
+        const std::size_t need = Align(HEADER + p_Size);
+        if (skip){
+            std::memcpy(&mBuffer[index], &WRAP, HEADER);
+        }
+        const std::size_t at = (index + skip) % mCapacity;
+        std::memcpy(&mBuffer[at], &p_Size, HEADER);
+        std::memcpy(&mBuffer[at + HEADER], p_Data, p_Size);
+        const std::uint64_t next = head + skip + need;
+        mHead.store(next, std::memory_order_release);
+        ++mRecords;
+        mPeakBytes = std::max<std::uint64_t>(mPeakBytes, next - tail);
+
+        if (next - mWrittenBack >= WRITEBACK_BYTES){
+            WriteBack(mWrittenBack, next);
+            mWrittenBack = next;
+        }
+        return true;
+    }
+
+    // the oldest record, it stays until PopFront().
+    bool Front(const std::uint8_t*& p_Data, std::size_t& p_Size) noexcept{
+
+        std::uint64_t tail = mTail.load(std::memory_order_relaxed);
+        const std::uint64_t head = mHead.load(std::memory_order_relaxed);
+        if (tail == head) return false;
+        std::uint32_t size;
+        std::memcpy(&size, &mBuffer[tail % mCapacity], HEADER);
+        if (size == WRAP){
+            tail += mCapacity - tail % mCapacity;
+            mTail.store(tail, std::memory_order_release);
+            std::memcpy(&size, &mBuffer[tail % mCapacity], HEADER);
+        }
+        p_Data = &mBuffer[tail % mCapacity + HEADER];
+        p_Size = size;
+        return true;
+    }
+
+    void PopFront() noexcept{
+
+        const std::uint64_t tail = mTail.load(std::memory_order_relaxed);
+        std::uint32_t size;
+        std::memcpy(&size, &mBuffer[tail % mCapacity], HEADER);
+        const std::uint64_t next = tail + Align(HEADER + size);
+        mTail.store(next, std::memory_order_release);
+
+        // whole chunks read back: out of the page cache, they were on the disk already.
+        if (next - mDropped >= WRITEBACK_BYTES){
+            Drop(mDropped, next);
+            mDropped = next;
+        }
+    }
+
+    // every spilled record, oldest first, without consuming. lock free reads of the mapping
+    // only, safe to call from a signal handler.
+    template<typename F>
+    std::size_t ForEach(F&& p_Sink) const noexcept{
+
+        if (!mBuffer) return 0;
+        std::uint64_t tail = mTail.load(std::memory_order_acquire);
+        const std::uint64_t head = mHead.load(std::memory_order_acquire);
+        std::size_t records = 0;
+        while (tail < head){
+            const std::size_t index = tail % mCapacity;
+            std::uint32_t size;
+            std::memcpy(&size, &mBuffer[index], HEADER);
+            if (size == WRAP){
+                tail += mCapacity - index;
+                continue;
+            }
+            p_Sink(&mBuffer[index + HEADER], size);
+            tail += Align(HEADER + size);
+            ++records;
+        }
+        return records;
+    }
+
+    void Close() noexcept{
+
+        if (mBuffer){
+            munmap(mBuffer, mCapacity);
+            mBuffer = nullptr;
+        }
+        if (mFd >= 0){
+            close(mFd);
+            mFd = -1;
+        }
+    }
+
+private:
+    static constexpr std::size_t HEADER{sizeof(std::uint32_t)};
+    static constexpr std::uint32_t WRAP{0xFFFFFFFF};
+
+    static constexpr std::size_t Align(std::size_t p_Size) noexcept{
+
+        return (p_Size + 7) & ~std::size_t{7};
+    }
+
+    // p_Index: where the head writes, p_Skip: bytes left at the end of the file for a wrap.
+    bool Fits(std::uint32_t p_Size, std::size_t& p_Index, std::size_t& p_Skip) const noexcept{
+
+        const std::uint64_t head = mHead.load(std::memory_order_relaxed);
+        const std::uint64_t tail = mTail.load(std::memory_order_relaxed);
+        const std::size_t need = Align(HEADER + p_Size);
+        p_Index = head % mCapacity;
+        p_Skip = (need > mCapacity - p_Index) ? mCapacity - p_Index : 0;
+        return p_Skip + need <= mCapacity - (head - tail);
+    }
+
+    // [p_From, p_To) in stream offsets, split where the file wraps.
+    template<typename F>
+    void ForRanges(std::uint64_t p_From, std::uint64_t p_To, F&& p_Range) const noexcept{
+
+        while (p_From < p_To){
+            const std::size_t index = p_From % mCapacity;
+            const std::size_t length = std::min<std::uint64_t>(p_To - p_From, mCapacity - index);
+            p_Range(index, length);
+            p_From += length;
+        }
+    }
+
+    // starts writeback without waiting for it.
+    void WriteBack(std::uint64_t p_From, std::uint64_t p_To) const noexcept{
+
+        ForRanges(p_From, p_To, [this](std::size_t p_Index, std::size_t p_Length){
+            sync_file_range(mFd, p_Index, p_Length, SYNC_FILE_RANGE_WRITE);
+        });
+    }
+
+    void Drop(std::uint64_t p_From, std::uint64_t p_To) const noexcept{
+
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        ForRanges(p_From, p_To, [this, page](std::size_t p_Index, std::size_t p_Length){
+            // whole pages, the one holding the next record stays. a page dropped with records
+            // still to read is only faulted in again, the mapping is backed by the file.
+            const std::size_t first = p_Index / page * page;
+            const std::size_t last = (p_Index + p_Length) / page * page;
+            if (last <= first) return;
+            madvise(mBuffer + first, last - first, MADV_DONTNEED);
+            posix_fadvise(mFd, first, last - first, POSIX_FADV_DONTNEED);
+        });
+    }
+
+    int mFd{-1};
+    std::size_t mCapacity{0};
+    std::uint8_t* mBuffer{nullptr};
+    std::atomic<std::uint64_t> mHead{0};
+    std::atomic<std::uint64_t> mTail{0};
+    std::uint64_t mWrittenBack{0};
+    std::uint64_t mDropped{0};
+    std::uint64_t mRecords{0};
+    std::uint64_t mFull{0};
+    std::uint64_t mPeakBytes{0};
+};
+
+#endif /* FLOG_SPILL_HPP */
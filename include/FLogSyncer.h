@@ -0,0 +1,129 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+enum class FLogDurability : std::uint8_t{
+  NONE,         // the kernel decides when lines reach the disk
+  INTERVAL,     // fdatasync at most every FlashLogger.fsync_interval_ms
+  CRIT          // fdatasync after every CRIT line
+};
+
+inline FLogDurability FLogDurabilityFrom(const std::string& p_Policy) noexcept{
+
+    return (p_Policy == "interval" ? FLogDurability::INTERVAL :
+            p_Policy == "crit" ? FLogDurability::CRIT : FLogDurability::NONE);
+}
+
+// Design note:
+// # - fdatasync can take milliseconds, it never runs on the consumer thread. the consumer
+//     pushes its stream buffer to the kernel, then only records "synced up to line N please".
+// # - requests arriving while a sync is running are merged into the next one.
+// # - p_OnSynced(N) runs on the syncer thread once lines 1..N are on the disk.
+class FLogSyncer{
+
+public:
+    using synced_callback_t = std::function<void(std::uint64_t p_Lines)>;
+
+    FLogSyncer() = default;
+    FLogSyncer(const FLogSyncer&) = delete;
+    FLogSyncer& operator=(const FLogSyncer&) = delete;
+
+    ~FLogSyncer(){
+
+        Stop();
+    }
+
+    // p_Fd < 0 (no file behind the sink): requests are completed right away.
+    // !p_Threaded: fdatasync runs inline in Request(), for hosts that allow no extra thread.
+    void Start(int p_Fd, synced_callback_t p_OnSynced, bool p_Threaded = true){
+
+        mFd = p_Fd;
+        mOnSynced = std::move(p_OnSynced);
+        if (mFd >= 0 && p_Threaded){
+            mThread = std::thread(&FLogSyncer::Run, this);
+        }
+    }
+
+    void Request(std::uint64_t p_Lines){
+
+        if (!mThread.joinable()){
+            if (mFd >= 0) fdatasync(mFd);
+            if (mOnSynced) mOnSynced(p_Lines);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequested = std::max(mRequested, p_Lines);
+            mPending = true;
+        }
+        mWakeUp.notify_one();
+    }
+
+    void Stop(){
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWakeUp.notify_one();
+        if (mThread.joinable()){
+            mThread.join();
+        }
+    }
+
+private:
+    void Run(){
+
+        while (true){
+            std::uint64_t lines = 0;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWakeUp.wait(lock, [this](){ return mPending || mStop; });
+                if (!mPending && mStop) return;
+                lines = mRequested;
+                mPending = false;
+            }
+            fdatasync(mFd);
+            mOnSynced(lines);
+        }
+    }
+
+    int mFd{-1};
+    synced_callback_t mOnSynced;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::uint64_t mRequested{0};
+    bool mPending{false};
+    bool mStop{false};
+    std::thread mThread;
+};
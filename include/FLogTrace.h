@@ -0,0 +1,139 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_TRACE_HPP
+#define FLOG_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "FLogUtilStructs.h"
+
+// Design note:
+// # - a span is one record: the usual header (end time, function, line) and a SPAN item with
+//     the elapsed ticks, the thread id and the span name. it takes the log line path, the
+//     timer itself costs two rdtsc.
+// # - ticks are converted to nanoseconds by the consumer, producers never divide.
+// # - FlashLogger.trace_spans switches the timers on, disabled they read no clock.
+
+// TSC on x86 (not serialising, a few cycles of skid are fine for spans), steady_clock elsewhere.
+struct FLogTickClock{
+
+    static std::uint64_t Now() noexcept{
+
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // ~10ms once, before the first span is recorded.
+    static void Calibrate() noexcept{
+
+        if (sNanosPerTick.load(std::memory_order_relaxed) != 0) return;
+#if defined(__x86_64__) || defined(__i386__)
+        const auto wallStart = std::chrono::steady_clock::now();
+        const std::uint64_t tickStart = Now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const auto wall = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wallStart).count();
+        const std::uint64_t ticks = Now() - tickStart;
+        sNanosPerTick.store(ticks ? wall / ticks : 1.0, std::memory_order_relaxed);
+#else
+        sNanosPerTick.store(1.0, std::memory_order_relaxed);
+#endif
+    }
+
+    static double ToNanos(std::uint64_t p_Ticks) noexcept{
+
+        return p_Ticks * sNanosPerTick.load(std::memory_order_relaxed);
+    }
+
+    static inline std::atomic<double> sNanosPerTick{0};
+};
+
+inline std::uint32_t FLogThreadId() noexcept{
+
+    static thread_local std::uint32_t s_Tid = 0;
+    if (!s_Tid) s_Tid = static_cast<std::uint32_t>(::syscall(SYS_gettid));
+    return s_Tid;
+}
+
+// Consumer side, per span name: count, sum, min, max and power of two buckets of nanoseconds.
+class FLogSpanStats{
+
+public:
+    struct Histogram{
+        std::uint64_t count{0};
+        double sum{0};
+        double min{0};
+        double max{0};
+        std::uint64_t buckets[64]{};
+
+        // upper bound of the bucket holding the p_Quantile'th span.
+        double Quantile(double p_Quantile) const noexcept{
+
+            const std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(p_Quantile * count));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < 64; ++i){
+                seen += buckets[i];
+                if (seen >= rank && seen) return std::min(max, std::ldexp(1.0, int(i) + 1));
+            }
+            return max;
+        }
+    };
+
+    void Add(std::string_view p_Name, double p_Nanos){
+
+        auto it = mSpans.find(p_Name);
+        if (it == mSpans.end()){
+            it = mSpans.emplace(std::string(p_Name), Histogram{}).first;
+        }
+        Histogram& h = it->second;
+        h.min = h.count ? std::min(h.min, p_Nanos) : p_Nanos;
+        h.max = std::max(h.max, p_Nanos);
+        h.sum += p_Nanos;
+        ++h.count;
+        ++h.buckets[p_Nanos < 1 ? 0 : std::min(63, std::ilogb(p_Nanos))];
+    }
+
+    const std::map<std::string, Histogram, std::less<>>& Spans() const noexcept{ return mSpans; }
+
+private:
+    // transparent comparator: looked up by the string_view into the slot, no allocation.
+    std::map<std::string, Histogram, std::less<>> mSpans;
+};
+
+#endif /* FLOG_TRACE_HPP */
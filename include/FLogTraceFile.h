@@ -0,0 +1,140 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef FLOG_TRACE_FILE_HPP
+#define FLOG_TRACE_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FLogRecord.h"
+
+// Design note:
+// # - FlashLogger.trace_file: the spans of the global logger as a Chrome trace in the JSON array
+//     format, loaded as it is by chrome://tracing and Perfetto. the log keeps its span lines.
+// # - one "complete" event per span: ts is its start, dur its length, in micro seconds.
+// # - consumer thread only. events are buffered and appended with write(2), the closing "]" is
+//     written at exit; both viewers also load a file a crash cut short without it.
+class FLogTraceFile{
+
+public:
+    FLogTraceFile() = default;
+    FLogTraceFile(const FLogTraceFile&) = delete;
+    FLogTraceFile& operator=(const FLogTraceFile&) = delete;
+
+    ~FLogTraceFile(){
+
+        Close();
+    }
+
+    bool Open(const std::string& p_Path){
+
+        mFd = open(p_Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (mFd < 0) return false;
+        mPid = getpid();
+        mLength = 0;
+        mEvents = 0;
+        Append("[");
+        return true;
+    }
+
+    bool IsOpen() const noexcept{ return mFd >= 0; }
+
+    // p_Header: the span's record header (end time, function, line), p_Span its SPAN item.
+    void Add(const FLogItem& p_Header, const FLogItem& p_Span) noexcept{
+
+        if (mLength + MAX_EVENT_SIZE > sizeof(mBuffer)){
+            Flush();
+        }
+        const double micros = FLogTickClock::ToNanos(p_Span.ticks) / 1000;
+        const std::uint64_t start = p_Header.now - std::min(static_cast<std::uint64_t>(micros), p_Header.now);
+        Append(mEvents++ ? ",\n{\"name\":\"" : "\n{\"name\":\"");
+        AppendEscaped(p_Span.str);
+        Append("\",\"cat\":\"flog\",\"ph\":\"X\",\"ts\":");
+        mLength = std::to_chars(mBuffer + mLength, mBuffer + sizeof(mBuffer), start).ptr - mBuffer;
+        Append(",\"dur\":");
+        mLength = std::to_chars(mBuffer + mLength, mBuffer + sizeof(mBuffer), micros, std::chars_format::fixed, 3).ptr - mBuffer;
+        Append(",\"pid\":");
+        mLength = std::to_chars(mBuffer + mLength, mBuffer + sizeof(mBuffer), mPid).ptr - mBuffer;
+        Append(",\"tid\":");
+        mLength = std::to_chars(mBuffer + mLength, mBuffer + sizeof(mBuffer), p_Span.u32).ptr - mBuffer;
+        Append(",\"args\":{\"func\":\"");
+        AppendEscaped(p_Header.str);
+        Append("\",\"line\":");
+        mLength = std::to_chars(mBuffer + mLength, mBuffer + sizeof(mBuffer), p_Header.line).ptr - mBuffer;
+        Append("}}");
+    }
+
+    // the buffered events to the file, the array stays open.
+    void Flush() noexcept{
+
+        std::size_t written = 0;
+        while (mFd >= 0 && written < mLength){
+            const ssize_t n = write(mFd, mBuffer + written, mLength - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += static_cast<std::size_t>(n);
+        }
+        mLength = 0;
+    }
+
+    void Close() noexcept{
+
+        if (mFd < 0) return;
+        Append("\n]\n");
+        Flush();
+        close(mFd);
+        mFd = -1;
+    }
+
+private:
+    // name and function are at most 255 bytes each, 6 per byte escaped.
+    static constexpr std::size_t MAX_EVENT_SIZE{2 * 255 * 6 + 256};
+
+    void Append(std::string_view p_Text) noexcept{
+
+        std::memcpy(mBuffer + mLength, p_Text.data(), p_Text.size());
+        mLength += p_Text.size();
+    }
+
+    void AppendEscaped(std::string_view p_Text) noexcept{
+
+        mLength = FLogJsonEscape(mBuffer + mLength, p_Text.data(), p_Text.size()) - mBuffer;
+    }
+
+    int mFd{-1};
+    pid_t mPid{0};
+    std::uint64_t mEvents{0};
+    std::size_t mLength{0};
+    char mBuffer[64 * 1024];
+};
+
+#endif /* FLOG_TRACE_FILE_HPP */
@@ -25,10 +25,13 @@
 #ifndef FLOG_UTIL_HPP
 #define FLOG_UTIL_HPP
 
+#include <cstdint>
 #include <variant>
 #include <array>
 #include <string>
 #include <chrono>
+#include <cstring>
+#include <memory>
 
 using namespace std::chrono_literals;
 const std::string s_copyright =
@@ -72,11 +75,42 @@ enum class GRANULARITY : uint8_t{
 };
 
 using supported_loggable_type = std::variant<const char*, unsigned int, int, double>;
+
+// name of a structured field, the next item is its value.
+struct FLogKey{
+    const char* name;
+};
+
+// line prefix, rendered by the consumer so producers never format time.
+struct FLogHeader{
+    std::uint64_t now;
+    const char* function;
+    std::uint32_t line;
+    LEVEL level;
+};
+
+// header line of the lines WarmUp()/PrepareThread() push: consumed like any other, never written.
+inline constexpr std::uint32_t FLOG_WARM_UP_LINE{0xFFFFFFFF};
+
+// a finished FLOG_SCOPE_TIMER / FLOG_TRACE_SPAN, p_Name is a literal.
+struct FLogSpan{
+    const char* name;
+    std::uint64_t ticks;
+    std::uint32_t tid;
+};
+
+// what travels from the log call to the ring.
+using flog_item_type = std::variant<const char*, unsigned int, int, double, FLogKey, FLogHeader, FLogSpan>;
 struct ProducerMsg{
 
-    ProducerMsg(bool p_IsEnd, std::array<supported_loggable_type, 8>&& p_Data):isEnd(p_IsEnd){ data.swap(p_Data); }
+    ProducerMsg(bool p_IsEnd, std::array<flog_item_type, 8>&& p_Data):isEnd(p_IsEnd){ data.swap(p_Data); }
+    // a finished record (backtrace dump), copied into a ring slot as is.
+    ProducerMsg(const std::uint8_t* p_Record, std::size_t p_Length)
+        :isEnd(true), raw(new std::uint8_t[p_Length]), rawLength(p_Length){ std::memcpy(raw.get(), p_Record, p_Length); }
     bool isEnd = false;
-    std::array<supported_loggable_type, 8> data;
+    std::array<flog_item_type, 8> data;
+    std::unique_ptr<std::uint8_t[]> raw;
+    std::size_t rawLength{0};
 };
 
 inline uint64_t FLogNow(){
@@ -84,13 +118,72 @@ inline uint64_t FLogNow(){
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
+// Header-only by default. Built as libFlashLogger (FlashLogger.cpp) and used with
+// FLOG_COMPILED_LIBRARY defined, the FLOG_EXTERNAL functions a call site goes through are
+// defined once in the library instead of in every translation unit.
+#if defined(FLOG_COMPILED_LIBRARY_SOURCE)
+#define FLOG_EXTERNAL __attribute__((visibility("default")))
+#define FLOG_DEFINE_EXTERNALS 1
+#elif defined(FLOG_COMPILED_LIBRARY)
+#define FLOG_EXTERNAL
+#define FLOG_DEFINE_EXTERNALS 0
+#else
+#define FLOG_EXTERNAL inline
+#define FLOG_DEFINE_EXTERNALS 1
+#endif
+
+// keeps rarely taken paths out of the call sites and out of the hot text.
+#define FLOG_COLD __attribute__((cold, noinline))
+#define FLOG_NOINLINE __attribute__((noinline))
+
 // helper constant for the visitor #3
 template<class>
 inline constexpr bool always_false_v = false;
 
-#define FLOG_INFO FLogLine() = FLogManager::globalInstance().getFlogLine(LEVEL::INFO, __FUNCTION__, __LINE__)
-#define FLOG_WARN FLogLine() = FLogManager::globalInstance().getFlogLine(LEVEL::WARN, __FUNCTION__, __LINE__)
-#define FLOG_CRIT FLogLine() = FLogManager::globalInstance().getFlogLine(LEVEL::CRIT, __FUNCTION__, __LINE__)
+#define FLOG_LINE(p_Logger, p_Level) FLogLine() = (p_Logger).getFlogLine(p_Level, __FUNCTION__, __LINE__)
+#define FLOG_INFO FLOG_LINE(FLogManager::globalInstance(), LEVEL::INFO)
+#define FLOG_WARN FLOG_LINE(FLogManager::globalInstance(), LEVEL::WARN)
+#define FLOG_CRIT FLOG_LINE(FLogManager::globalInstance(), LEVEL::CRIT)
+
+// Named loggers from "FlashLogger.category": FLOG_INFO_TO("market_data") << px;
+// the name is looked up once per call site, afterwards it is a cached reference.
+#define FLOG_CATEGORY(p_Name) \
+    ([]() -> FLogManager& { static FLogManager& s_Logger = FLogManager::Category(p_Name); return s_Logger; }())
+#define FLOG_INFO_TO(p_Name) FLOG_LINE(FLOG_CATEGORY(p_Name), LEVEL::INFO)
+#define FLOG_WARN_TO(p_Name) FLOG_LINE(FLOG_CATEGORY(p_Name), LEVEL::WARN)
+#define FLOG_CRIT_TO(p_Name) FLOG_LINE(FLOG_CATEGORY(p_Name), LEVEL::CRIT)
+
+// FLOG_INFO_FMT("order {} filled {} @ {}", id, qty, px); format is checked at compile time.
+#define FLOG_FMT_STRING(p_Fmt) []() constexpr { return std::string_view(p_Fmt); }
+#define FLOG_INFO_FMT(p_Fmt, ...) (FLOG_INFO).Format(FLOG_FMT_STRING(p_Fmt), ##__VA_ARGS__)
+#define FLOG_WARN_FMT(p_Fmt, ...) (FLOG_WARN).Format(FLOG_FMT_STRING(p_Fmt), ##__VA_ARGS__)
+#define FLOG_CRIT_FMT(p_Fmt, ...) (FLOG_CRIT).Format(FLOG_FMT_STRING(p_Fmt), ##__VA_ARGS__)
+
+// Per call site throttles, the limiter is a static of the expansion and runs after the level check.
+// FLOG_WARN_EVERY_N(1000) << ...;  FLOG_WARN_RATE(10) << ...;  (at most 10 lines per second)
+#define FLOG_SITE_PASS(p_Level, p_Limiter) \
+    (FLogManager::globalInstance().toLog(p_Level) && \
+     (!FLogManager::globalInstance().LimitersEnabled() || []() noexcept { static p_Limiter s_Site; return s_Site.Pass(); }()))
+#define FLOG_LIMITED(p_Level, p_Limiter) \
+    FLogLine() = FLogManager::globalInstance().getFlogLine(p_Level, __FUNCTION__, __LINE__, FLOG_SITE_PASS(p_Level, p_Limiter))
+#define FLOG_INFO_ONCE FLOG_LIMITED(LEVEL::INFO, FLogOnce)
+#define FLOG_WARN_ONCE FLOG_LIMITED(LEVEL::WARN, FLogOnce)
+#define FLOG_CRIT_ONCE FLOG_LIMITED(LEVEL::CRIT, FLogOnce)
+#define FLOG_INFO_EVERY_N(p_N) FLOG_LIMITED(LEVEL::INFO, FLogEveryN<p_N>)
+#define FLOG_WARN_EVERY_N(p_N) FLOG_LIMITED(LEVEL::WARN, FLogEveryN<p_N>)
+#define FLOG_CRIT_EVERY_N(p_N) FLOG_LIMITED(LEVEL::CRIT, FLogEveryN<p_N>)
+#define FLOG_INFO_RATE(p_PerSecond) FLOG_LIMITED(LEVEL::INFO, FLogRateLimit<p_PerSecond>)
+#define FLOG_WARN_RATE(p_PerSecond) FLOG_LIMITED(LEVEL::WARN, FLogRateLimit<p_PerSecond>)
+#define FLOG_CRIT_RATE(p_PerSecond) FLOG_LIMITED(LEVEL::CRIT, FLogRateLimit<p_PerSecond>)
+
+// FLOG_WARN_FMT_DEDUP("queue {} full", id); the whole line is needed to compare, so format API only.
+#define FLOG_FMT_DEDUP(p_Level, p_Fmt, ...) \
+    (FLogLine() = FLogManager::globalInstance().getFlogLineDeferred(p_Level)) \
+        .FormatDedup(p_Level, __FUNCTION__, __LINE__, FLogManager::globalInstance().LimitersEnabled(), \
+                     FLOG_FMT_STRING(p_Fmt), ##__VA_ARGS__)
+#define FLOG_INFO_FMT_DEDUP(p_Fmt, ...) FLOG_FMT_DEDUP(LEVEL::INFO, p_Fmt, ##__VA_ARGS__)
+#define FLOG_WARN_FMT_DEDUP(p_Fmt, ...) FLOG_FMT_DEDUP(LEVEL::WARN, p_Fmt, ##__VA_ARGS__)
+#define FLOG_CRIT_FMT_DEDUP(p_Fmt, ...) FLOG_FMT_DEDUP(LEVEL::CRIT, p_Fmt, ##__VA_ARGS__)
 
 #endif /* FLOG_UTIL_HPP */
 
@@ -24,19 +24,327 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "FLogUtilStructs.h"
+#include "FLogCrashHandler.h"
 #if(USE_MICROSERVICE)
 #include "FLogMicroServiceWritter.h"
-#else
+#endif
 #include "FLogFileWritter.h"
+#include "FLogSocketWritter.h"
+
+// the sinks of every logger, in order. a build may list its own:
+// -DFLOG_SINKS=FLogFileWritter,FLogSocketWritter
+#ifndef FLOG_SINKS
+#if(USE_MICROSERVICE)
+#define FLOG_SINKS FLogMicroServiceWritter
+#elif(USE_SOCKET_SINK)
+#define FLOG_SINKS FLogSocketWritter
+#else
+#define FLOG_SINKS FLogFileWritter
+#endif
 #endif
 
+// Bounded single producer / single consumer queue of byte records: u32 length | bytes, 8 byte
+// aligned. a record never wraps, the tail of the buffer is skipped instead.
+class FLogSinkQueue{
+
+public:
+    explicit FLogSinkQueue(std::size_t p_Bytes)
+        :mCapacity(std::max<std::size_t>(p_Bytes, 64 * 1024) & ~std::size_t{7}),
+         mBuffer(new std::uint8_t[mCapacity]()){ }   // zeroed: paged in here, not by the first lines
+
+    // producer. false: no room, nothing is written.
+    bool Push(const std::uint8_t* p_Data, std::uint32_t p_Size) noexcept{
+
+        const std::uint64_t head = mHead.load(std::memory_order_relaxed);
+        const std::uint64_t tail = mTail.load(std::memory_order_acquire);
+        const std::size_t need = Align(HEADER + p_Size);
+        const std::size_t index = head % mCapacity;
+        const std::size_t skip = (need > mCapacity - index) ? mCapacity - index : 0;
+        if (skip + need > mCapacity - (head - tail)) return false;
+        if (skip){
+            std::memcpy(&mBuffer[index], &WRAP, HEADER);
+        }
+        const std::size_t at = (index + skip) % mCapacity;
+        std::memcpy(&mBuffer[at], &p_Size, HEADER);
+        std::memcpy(&mBuffer[at + HEADER], p_Data, p_Size);
+        mHead.store(head + skip + need, std::memory_order_release);
+        return true;
+    }
+
+    // consumer. hands every queued record to p_Sink(data, size), returns how many.
+    template<typename F>
+    std::size_t Pop(F&& p_Sink){
+
+        std::uint64_t tail = mTail.load(std::memory_order_relaxed);
+        const std::uint64_t head = mHead.load(std::memory_order_acquire);
+        std::size_t records = 0;
+        while (tail != head){
+            const std::size_t index = tail % mCapacity;
+            std::uint32_t size;
+            std::memcpy(&size, &mBuffer[index], HEADER);
+            if (size == WRAP){
+                tail += mCapacity - index;
+                continue;
+            }
+            p_Sink(&mBuffer[index + HEADER], size);
+            tail += Align(HEADER + size);
+            mTail.store(tail, std::memory_order_release);
+            ++records;
+        }
+        mTail.store(tail, std::memory_order_release);
+        return records;
+    }
+
+    // crash handler: every queued record, nothing is popped. the consumer may be popping too.
+    template<typename F>
+    std::size_t ForEach(F&& p_Sink) const noexcept{
+
+        std::uint64_t tail = mTail.load(std::memory_order_acquire);
+        const std::uint64_t head = mHead.load(std::memory_order_acquire);
+        std::size_t records = 0;
+        while (tail != head){
+            const std::size_t index = tail % mCapacity;
+            std::uint32_t size;
+            std::memcpy(&size, &mBuffer[index], HEADER);
+            if (size == WRAP){
+                tail += mCapacity - index;
+                continue;
+            }
+            p_Sink(&mBuffer[index + HEADER], size);
+            tail += Align(HEADER + size);
+            ++records;
+        }
+        return records;
+    }
+
+private:
+    static constexpr std::size_t HEADER{sizeof(std::uint32_t)};
+    static constexpr std::uint32_t WRAP{0xFFFFFFFF};
+
+    static constexpr std::size_t Align(std::size_t p_Size) noexcept{
+
+        return (p_Size + 7) & ~std::size_t{7};
+    }
+
+    const std::size_t mCapacity;
+    std::unique_ptr<std::uint8_t[]> mBuffer;
+    alignas(64) std::atomic<std::uint64_t> mHead{0};
+    alignas(64) std::atomic<std::uint64_t> mTail{0};
+};
+
+// a sink behind the primary one: its own queue and thread, or written inline when the
+// logger runs threadless (background_threads = 0).
 template<typename T>
-class FLogWritter : public T
+class FLogSinkLane{
+
+public:
+    template<typename CONFIG>
+    explicit FLogSinkLane(const CONFIG& p_Data)
+        :mSink(std::make_from_tuple<T>(T::ConfigArgs(p_Data))),
+         mQueue(std::size_t{p_Data.sink_queue_kb} * 1024){
+
+        if (p_Data.background_threads != 0){
+            mThread = std::thread(&FLogSinkLane::Run, this);
+        }
+    }
+
+    FLogSinkLane(const FLogSinkLane&) = delete;
+    FLogSinkLane& operator=(const FLogSinkLane&) = delete;
+
+    ~FLogSinkLane(){
+
+        mStop.store(true, std::memory_order_release);
+        if (mThread.joinable()){
+            mThread.join();
+        }
+    }
+
+    void Write(const std::uint8_t* p_Data, int p_Size){
+
+        if (!mThread.joinable()){
+            mSink.WriteToFile(p_Data, p_Size);
+        }else if (!mQueue.Push(p_Data, static_cast<std::uint32_t>(p_Size))){
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // threaded: the lane thread flushes once what is queued now is written, Flushed() tells.
+    void Flush(){
+
+        const std::uint64_t asked = mFlushesAsked.fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (!mThread.joinable()){
+            mSink.Flush();
+            mFlushesDone.store(asked, std::memory_order_release);
+        }
+    }
+
+    // has the sink flushed for the p_Flush'th Flush() call?
+    bool Flushed(std::uint64_t p_Flush) const noexcept{
+
+        return mFlushesDone.load(std::memory_order_acquire) >= p_Flush;
+    }
+
+    void Idle(){
+
+        if (!mThread.joinable()) mSink.Idle();
+    }
+
+    // crash handler: the sink's own crash path, then what is still queued. the lane thread
+    // keeps running meanwhile, a record it writes at the same time can appear twice.
+    void FlushForCrash() noexcept{
+
+        const int fd = mSink.FlushForCrash();
+        mQueue.ForEach([fd](const std::uint8_t* p_Data, std::uint32_t p_Size){
+            FLogCrashHandler::WriteAll(fd, p_Data, p_Size);
+        });
+    }
+
+    std::atomic<LEVEL> mLevel{LEVEL::CRIT};
+    std::atomic<std::uint64_t> mDropped{0};
+
+private:
+    void Run(){
+
+        while (true){
+            // flags first: lines queued before a flush request are drained before it is served.
+            const std::uint64_t asked = mFlushesAsked.load(std::memory_order_acquire);
+            const bool stop = mStop.load(std::memory_order_acquire);
+            const std::size_t written = mQueue.Pop([this](const std::uint8_t* p_Data, std::uint32_t p_Size){
+                mSink.WriteToFile(p_Data, static_cast<int>(p_Size));
+            });
+            if (asked != mFlushesDone.load(std::memory_order_relaxed) || stop){
+                mSink.Flush();
+                mFlushesDone.store(asked, std::memory_order_release);
+            }
+            if (stop) return;
+            if (!written){
+                mSink.Idle();
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        }
+    }
+
+    T mSink;
+    FLogSinkQueue mQueue;
+    std::atomic<std::uint64_t> mFlushesAsked{0};
+    std::atomic<std::uint64_t> mFlushesDone{0};
+    std::atomic_bool mStop{false};
+    std::thread mThread;
+};
+
+// Design note:
+// # - FLogWritter<Sinks...> is a type list: every call is dispatched statically, no virtual
+//     call, and the one sink build pays one relaxed load for the sink level and nothing else.
+// # - the first sink is the primary one, written inline on the consumer thread. its Offset()
+//     and Fd() drive the index and the durability policy, so it has no queue: a slow primary
+//     holds the consumer, and the consumer feeds every lane, so the lanes wait with it.
+// # - every other sink has a lane (a bounded queue and a thread). a slow or stalled lane fills
+//     its own queue and loses lines, counted in Dropped(); it never holds the consumer, the
+//     primary sink or the other lanes.
+// # - on a crash the lanes write what they still queue to their sinks. the records left in
+//     the ring are rendered once, to the primary sink only.
+// # - every sink has a level, same meaning as log_level (FlashLogger.sink_levels =
+//     "file:CRIT,socket:WARN"). records without a level (copyright, summaries) go to all.
+template<typename Primary, typename... Others>
+class FLogWritter
 {
 public:
-    FLogWritter(const std::string& p_Data):T(p_Data){ }
+    template<typename CONFIG>
+    explicit FLogWritter(const CONFIG& p_Data)
+        :mPrimary(std::make_from_tuple<Primary>(Primary::ConfigArgs(p_Data))),
+         mLanes(((void)sizeof(Others), p_Data)...){ }
 
+    // a record without a level: every sink.
     bool WriteToFile(const std::uint8_t* data, int size) {
-        return T::WriteToFile(data, size);
+        std::apply([data, size](auto&... lane){ (lane.Write(data, size), ...); }, mLanes);
+        return mPrimary.WriteToFile(data, size);
+    }
+
+    bool Write(LEVEL p_Level, const std::uint8_t* data, int size) {
+        std::apply([p_Level, data, size](auto&... lane){
+            ((lane.mLevel.load(std::memory_order_relaxed) >= p_Level ? lane.Write(data, size) : void()), ...);
+        }, mLanes);
+        return mPrimaryLevel.load(std::memory_order_relaxed) >= p_Level ? mPrimary.WriteToFile(data, size) : true;
     }
+
+    // lanes flush on their own thread once what was queued before is written: LanesFlushed()
+    // with Flushes() taken after this call tells when they have.
+    bool Flush() {
+        ++mFlushes;
+        std::apply([](auto&... lane){ (lane.Flush(), ...); }, mLanes);
+        return mPrimary.Flush();
+    }
+
+    std::uint64_t Flushes() const noexcept {
+        return mFlushes;
+    }
+
+    bool LanesFlushed(std::uint64_t p_Flush) const noexcept {
+        return std::apply([p_Flush](const auto&... lane){ return (lane.Flushed(p_Flush) && ...); }, mLanes);
+    }
+
+    void Idle() {
+        std::apply([](auto&... lane){ (lane.Idle(), ...); }, mLanes);
+        mPrimary.Idle();
+    }
+
+    int Fd() const noexcept {
+        return mPrimary.Fd();
+    }
+
+    std::uint64_t Offset() const noexcept {
+        return mPrimary.Offset();
+    }
+
+    int FlushForCrash() noexcept {
+        std::apply([](auto&... lane){ (lane.FlushForCrash(), ...); }, mLanes);
+        return mPrimary.FlushForCrash();
+    }
+
+    // "name:LEVEL,name:LEVEL" by the sinks' NAME, sinks not listed take every line.
+    void SetLevels(const std::string& p_Levels) {
+        std::istringstream in(p_Levels);
+        std::string entry;
+        auto set = [](std::atomic<LEVEL>& p_Level, const char* p_Name, const std::string& p_Entry){
+            const auto colon = p_Entry.find(':');
+            if (p_Entry.compare(0, colon, p_Name) != 0) return;
+            const std::string level = p_Entry.substr(colon + 1);
+            p_Level.store(level == "INFO" ? LEVEL::INFO : level == "WARN" ? LEVEL::WARN : LEVEL::CRIT,
+                          std::memory_order_relaxed);
+        };
+        mPrimaryLevel.store(LEVEL::CRIT, std::memory_order_relaxed);
+        std::apply([](auto&... lane){ (lane.mLevel.store(LEVEL::CRIT, std::memory_order_relaxed), ...); }, mLanes);
+        while (std::getline(in, entry, ',')){
+            if (entry.find(':') == std::string::npos) continue;
+            set(mPrimaryLevel, Primary::NAME, entry);
+            std::apply([&](auto&... lane){ (set(lane.mLevel, Others::NAME, entry), ...); }, mLanes);
+        }
+    }
+
+    // lines lost by lanes whose queue was full.
+    std::uint64_t Dropped() const noexcept {
+        std::uint64_t dropped = 0;
+        std::apply([&dropped](const auto&... lane){ ((dropped += lane.mDropped.load(std::memory_order_relaxed)), ...); }, mLanes);
+        return dropped;
+    }
+
+private:
+    Primary mPrimary;
+    std::atomic<LEVEL> mPrimaryLevel{LEVEL::CRIT};
+    // Flush() calls, every lane has been asked as many times.
+    std::uint64_t mFlushes{0};
+    std::tuple<FLogSinkLane<Others>...> mLanes;
 };
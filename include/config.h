@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <vector>
 #include <boost/program_options.hpp>
 #include <boost/program_options/options_description.hpp>
 
@@ -44,12 +45,36 @@ public:
             ss << "Failed to open config file " << config_name << std::endl;
             throw std::runtime_error(ss.str());
         }
-        store(po::parse_command_line(argc, argv, desc), vm);
+        // options of the host program (e.g. --gtest_*) are left to it.
+        store(po::command_line_parser(argc, argv).options(desc).allow_unregistered().run(), vm);
         store(po::parse_config_file(file, desc, true), vm);
 
         notify(vm);
     }
 
+    // parses the config file again into a fresh config_data_t, data() is left untouched
+    // so readers on other threads never see a half updated string.
+    config_data_t reload() const noexcept(false) {
+        config_data_t fresh;
+        po::options_description fresh_desc;
+        add_options(fresh, fresh_desc);
+
+        std::ifstream file(config_name.c_str());
+        if(!file) {
+            std::stringstream ss;
+            ss << "Failed to open config file " << config_name << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        po::variables_map fresh_vm;
+        store(po::parse_config_file(file, fresh_desc, true), fresh_vm);
+        notify(fresh_vm);
+        return fresh;
+    }
+
+    const std::string& file_name() const {
+        return config_name;
+    }
+
     template <typename T = std::string>
     auto &get(const char *needle) noexcept(false) {
         try {
@@ -98,6 +123,10 @@ std::ostream& operator<<(std::ostream& s, const config<DATA>& c) {
         else if (auto v = boost::any_cast<std::string>(&value)) {
             s << *v << std::endl;
         }
+        else if (auto v = boost::any_cast<std::vector<std::string>>(&value)) {
+            for (const auto& item : *v) s << item << "; ";
+            s << std::endl;
+        }
         else {
             s << "error" << std::endl;
         }
@@ -112,10 +141,108 @@ struct flashlogger_config_data {
     short run_test;
     std::string server_ip;
     std::string server_port;
+    std::string output_format;
+    short crash_handler;
+    std::string shm_name;
+    std::vector<std::string> categories;
+    std::string log_level;
+    std::string granularity;
+    short rate_limit{1};
+    unsigned int flush_every{0};
+    short hot_reload{0};
+    unsigned int backtrace{0};
+    std::string durability;
+    short background_threads{1};
+    short trace_spans{0};
+    std::string trace_file;
+    short profile_sites{0};
+    unsigned int profile_report_s{0};
+    unsigned int index_every{0};
+    std::string socket_endpoint;
+    unsigned int socket_queue_kb{1024};
+    std::string sink_levels;
+    unsigned int sink_queue_kb{4096};
+    std::string remote_codec;
+    int remote_level{0};
+    unsigned int remote_batch_kb{64};
+    unsigned int remote_batch_ms{5};
+    unsigned int remote_dict_lines{1000};
+    unsigned int format_threads{0};
+    short warm_up{0};
+    std::string capture_file;
+    std::string spill_file;
+    unsigned int spill_mb{256};
+    unsigned int spill_high{75};
+    unsigned int spill_low{25};
+    unsigned int fsync_interval_ms{100};
 
     flashlogger_config_data() = default;
+
+    // what a key left out of the config file is set to.
+    static flashlogger_config_data defaults() {
+        flashlogger_config_data d;
+        d.size_of_ring_buffer = 50;
+        d.log_file_path = "../";
+        d.log_file_name = "flashlog.txt";
+        d.run_test = 1;
+        d.server_ip = "localhost";
+        d.server_port = "50051";
+        d.output_format = "text";
+        d.crash_handler = 0;
+        d.durability = "none";
+        d.socket_endpoint = "unix:/tmp/flashlog.sock";
+        d.remote_codec = "none";
+        return d;
+    }
 };
 using FLogConfig = config<flashlogger_config_data>;
 
+// every FlashLogger.* key, for the add_options of a FLogConfig. a program changes the
+// p_Defaults it needs and adds its own keys after these.
+inline void add_flashlogger_options(flashlogger_config_data &d, po::options_description &desc,
+                                    const flashlogger_config_data &p_Defaults = flashlogger_config_data::defaults()) {
+    desc.add_options()
+            ("FlashLogger.size_of_ring_buffer", po::value<short>(&d.size_of_ring_buffer)->default_value(p_Defaults.size_of_ring_buffer), "size of buffer to log asyncoronously")
+            ("FlashLogger.log_file_path", po::value<std::string>(&d.log_file_path)->default_value(p_Defaults.log_file_path), "log file path")
+            ("FlashLogger.log_file_name", po::value<std::string>(&d.log_file_name)->default_value(p_Defaults.log_file_name), "log file name")
+            ("FlashLogger.run_test", po::value<short>(&d.run_test)->default_value(p_Defaults.run_test), "choose to run test")
+            ("FlashLogger.server_ip", po::value<std::string>(&d.server_ip)->default_value(p_Defaults.server_ip), "microservice server IP")
+            ("FlashLogger.server_port", po::value<std::string>(&d.server_port)->default_value(p_Defaults.server_port), "microservice server port")
+            ("FlashLogger.output_format", po::value<std::string>(&d.output_format)->default_value(p_Defaults.output_format), "text, json, binary or rfc5424")
+            ("FlashLogger.crash_handler", po::value<short>(&d.crash_handler)->default_value(p_Defaults.crash_handler), "flush in-flight lines on fatal signals")
+            ("FlashLogger.shm_name", po::value<std::string>(&d.shm_name)->default_value(p_Defaults.shm_name), "shared memory ring prefix, drained by flashlogd")
+            ("FlashLogger.category", po::value<std::vector<std::string>>(&d.categories)->composing(), "named logger \"<name> ring=N file=F level=L granularity=G format=F\", repeatable")
+            ("FlashLogger.log_level", po::value<std::string>(&d.log_level)->default_value(p_Defaults.log_level), "INFO, WARN or CRIT, FLOG_LOG_LEVEL wins at start up")
+            ("FlashLogger.granularity", po::value<std::string>(&d.granularity)->default_value(p_Defaults.granularity), "BASIC or FULL, FLOG_GRANULARITY wins at start up")
+            ("FlashLogger.rate_limit", po::value<short>(&d.rate_limit)->default_value(p_Defaults.rate_limit), "0 lets every FLOG_*_ONCE/_EVERY_N/_RATE/_FMT_DEDUP line through")
+            ("FlashLogger.flush_every", po::value<unsigned int>(&d.flush_every)->default_value(p_Defaults.flush_every), "flush the sink every N lines, 0 leaves it to the stream buffer")
+            ("FlashLogger.hot_reload", po::value<short>(&d.hot_reload)->default_value(p_Defaults.hot_reload), "re-read the live settings on config file change or SIGHUP")
+            ("FlashLogger.backtrace", po::value<unsigned int>(&d.backtrace)->default_value(p_Defaults.backtrace), "keep the last N filtered lines per thread, written before the next FLOG_CRIT")
+            ("FlashLogger.durability", po::value<std::string>(&d.durability)->default_value(p_Defaults.durability), "none, interval or crit: when the sink is fdatasync'ed")
+            ("FlashLogger.fsync_interval_ms", po::value<unsigned int>(&d.fsync_interval_ms)->default_value(p_Defaults.fsync_interval_ms), "fdatasync period of durability = interval")
+            ("FlashLogger.background_threads", po::value<short>(&d.background_threads)->default_value(p_Defaults.background_threads), "0: no logger threads, the host calls FLogManager::Poll()")
+            ("FlashLogger.trace_spans", po::value<short>(&d.trace_spans)->default_value(p_Defaults.trace_spans), "record FLOG_SCOPE_TIMER / FLOG_TRACE_SPAN")
+            ("FlashLogger.trace_file", po::value<std::string>(&d.trace_file)->default_value(p_Defaults.trace_file), "also write the spans as a Chrome trace (JSON array) for chrome://tracing or Perfetto")
+            ("FlashLogger.profile_sites", po::value<short>(&d.profile_sites)->default_value(p_Defaults.profile_sites), "count lines, bytes, drops and time per log call site")
+            ("FlashLogger.profile_report_s", po::value<unsigned int>(&d.profile_report_s)->default_value(p_Defaults.profile_report_s), "log the noisiest call sites every N seconds, 0: at exit only")
+            ("FlashLogger.index_every", po::value<unsigned int>(&d.index_every)->default_value(p_Defaults.index_every), "write <log file>.idx, one block per N records and per second, for flog-query")
+            ("FlashLogger.socket_endpoint", po::value<std::string>(&d.socket_endpoint)->default_value(p_Defaults.socket_endpoint), "socket sink (-DSOCKET_SINK=ON): unix:<path>, unix-stream:<path> or udp:<host>:<port>")
+            ("FlashLogger.socket_queue_kb", po::value<unsigned int>(&d.socket_queue_kb)->default_value(p_Defaults.socket_queue_kb), "socket sink: records the receiver has not taken yet, beyond this they are dropped")
+            ("FlashLogger.sink_levels", po::value<std::string>(&d.sink_levels)->default_value(p_Defaults.sink_levels), "level per sink, \"file:CRIT,socket:WARN\", sinks not listed take every line")
+            ("FlashLogger.sink_queue_kb", po::value<unsigned int>(&d.sink_queue_kb)->default_value(p_Defaults.sink_queue_kb), "queue of every sink after the first, a slow sink drops lines beyond it")
+            ("FlashLogger.remote_codec", po::value<std::string>(&d.remote_codec)->default_value(p_Defaults.remote_codec), "gRPC sink: none, lz4, zstd or zlib, each block compressed on the consumer thread")
+            ("FlashLogger.remote_level", po::value<int>(&d.remote_level)->default_value(p_Defaults.remote_level), "gRPC sink: codec level (lz4: acceleration), 0: the codec's default")
+            ("FlashLogger.remote_batch_kb", po::value<unsigned int>(&d.remote_batch_kb)->default_value(p_Defaults.remote_batch_kb), "gRPC sink: lines per RPC, a batch is also sent when the ring runs empty")
+            ("FlashLogger.remote_batch_ms", po::value<unsigned int>(&d.remote_batch_ms)->default_value(p_Defaults.remote_batch_ms), "gRPC sink: a batch sent because the ring ran empty is at least this old, 0: right away")
+            ("FlashLogger.remote_dict_lines", po::value<unsigned int>(&d.remote_dict_lines)->default_value(p_Defaults.remote_dict_lines), "gRPC sink: the codec dictionary is one line per call site out of the first N lines, 0: none")
+            ("FlashLogger.format_threads", po::value<unsigned int>(&d.format_threads)->default_value(p_Defaults.format_threads), "threads rendering lines for the consumer, in ring order, 0: the consumer renders")
+            ("FlashLogger.warm_up", po::value<short>(&d.warm_up)->default_value(p_Defaults.warm_up), "run WarmUp() at start up: first lines cost what later ones do")
+            ("FlashLogger.capture_file", po::value<std::string>(&d.capture_file)->default_value(p_Defaults.capture_file), "record the shape of every line (time, thread, call site, argument types) for flog-replay")
+            ("FlashLogger.spill_file", po::value<std::string>(&d.spill_file)->default_value(p_Defaults.spill_file), "overflow file on a local disk, the consumer spills ring records to it past spill_high")
+            ("FlashLogger.spill_mb", po::value<unsigned int>(&d.spill_mb)->default_value(p_Defaults.spill_mb), "size of the spill file, preallocated at start up")
+            ("FlashLogger.spill_high", po::value<unsigned int>(&d.spill_high)->default_value(p_Defaults.spill_high), "ring occupancy in percent which starts spilling")
+            ("FlashLogger.spill_low", po::value<unsigned int>(&d.spill_low)->default_value(p_Defaults.spill_low), "ring occupancy in percent down to which it spills, the file is written back to the sink below");
+}
+
 #endif /* CONFIG_HPP */
 
@@ -23,7 +23,27 @@
 // Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
 
 #include "FLogManager.h"
+#include "FLogSocketWritter.h"
+#include "FLogCodec.h"
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <sys/wait.h>
+
+// a logger apart from the suite's global one, p_Data as its settings. the config file behind
+// it is empty and gone once parsed, p_Data.hot_reload has nothing to watch.
+std::unique_ptr<FLogManager> MakeTestLogger(const flashlogger_config_data& p_Data){
+
+    std::ofstream("./flog_test_logger.cfg").flush();
+    auto config = std::make_unique<FLogConfig>([p_Data](flashlogger_config_data& d, boost::program_options::options_description&){
+        d = p_Data;
+    });
+    const char* argv[] = {"flog", "--config", "./flog_test_logger.cfg"};
+    config->parse(3, const_cast<char**>(argv));
+    std::remove("./flog_test_logger.cfg");
+    auto logger = std::make_unique<FLogManager>(std::move(config));
+    logger->SetCopyrightAndStartService("");
+    return logger;
+}
 
 TEST(FlashLoggerTest, LOG_INFO) {
 
@@ -52,12 +72,858 @@ TEST(FlashLoggerTest, LOG_CRITICAL) {
     FLOG_WARN << "Hello World Test WARN";
     FLOG_CRIT << "Hello World Test CRIT";
 }
+TEST(FlashLoggerTest, LOG_FORMAT) {
+
+    FLogManager::globalInstance().SetLogLevel("INFO");
+
+    static_assert(FLogFormatSlotCount("order {} filled {} @ {}") == 3);
+    static_assert(FLogFormatIsValid("{{literal}} {}") && !FLogFormatIsValid("{0}"));
+    constexpr FLogFormatSegments<14, 1> segments{"{{literal}} {}"};
+    EXPECT_STREQ(segments.Segment(0), "{literal} ");
+    EXPECT_STREQ(segments.Segment(1), "");
+
+    for(unsigned int i = 0; i < 1000; i++){
+
+        FLOG_INFO_FMT("order {} filled {} @ {}", i, static_cast<int>(i - 1000), static_cast<double>(i));
+    }
+    FLOG_WARN_FMT("no arguments");
+}
+TEST(FlashLoggerTest, LOG_STRUCTURED) {
+
+    FLogManager::globalInstance().SetLogLevel("INFO");
+
+    std::uint8_t slot[sizeof(FLogLine)];
+    FLogRecordWriter record(slot, sizeof(slot));
+    record.Put(FLogHeader{1000001, "TestBody", 7, LEVEL::WARN});
+    record.Put(" filled \"all\"\n");
+    record.Put(FLogKey{"order_id"});
+    record.Put(42u);
+    record.Put(FLogKey{"px"});
+    record.Put(1.5);
+
+    FLogRecordRenderer json(FLogOutputFormat::JSON);
+    std::string line(reinterpret_cast<const char*>(json.Data()), json.Render(slot, record.Length()));
+    EXPECT_EQ(line, "{\"ts\":1000001,\"level\":\"WARN\",\"func\":\"TestBody\",\"line\":7,"
+                    "\"msg\":\" filled \\\"all\\\"\\n\",\"order_id\":42,\"px\":1.5}\n");
+
+    FLogRecordRenderer text(FLogOutputFormat::TEXT);
+    line.assign(reinterpret_cast<const char*>(text.Data()), text.Render(slot, record.Length()));
+    EXPECT_NE(line.find("][ TestBody : 7 ] filled \"all\"\n order_id=42 px=1.500000 \n"), std::string::npos);
+
+    FLogRecordRenderer syslog(FLogOutputFormat::RFC5424);
+    line.assign(reinterpret_cast<const char*>(syslog.Data()), syslog.Render(slot, record.Length()));
+    EXPECT_EQ(line.rfind("<12>1 1970-01-01T00:00:01.000001Z ", 0), 0u);
+    EXPECT_NE(line.find(" - [flog@32473 func=\"TestBody\" line=\"7\"]  filled \"all\"\n order_id=42 px=1.500000\n"), std::string::npos);
+
+    FLogRecordRenderer binary(FLogOutputFormat::BINARY);
+    EXPECT_EQ(binary.Render(slot, record.Length()), record.Length() + 3);
+
+    char escaped[128];
+    const char* raw = "0123456789abcdef\"0123456789\tabcdef";
+    EXPECT_EQ(std::string(escaped, FLogJsonEscape(escaped, raw, strlen(raw))),
+              "0123456789abcdef\\\"0123456789\\tabcdef");
+
+    for(unsigned int i = 0; i < 1000; i++){
+
+        FLOG_INFO.kv("order_id", i).kv("px", static_cast<double>(i)) << "filled";
+    }
+}
+TEST(FlashLoggerTest, LOG_RENDER_BOUNDS) {
+
+    // ~310 characters each in fixed notation: a slot of them renders past MAX_RENDERED_SIZE.
+    std::uint8_t slot[sizeof(FLogLine)];
+    FLogRecordWriter record(slot, sizeof(slot));
+    record.Put(FLogHeader{1000001, "TestBody", 7, LEVEL::WARN});
+    while (record.Put(1e300));
+    std::uint8_t keyed[sizeof(FLogLine)];
+    FLogRecordWriter pairs(keyed, sizeof(keyed));
+    pairs.Put(FLogHeader{1000001, "TestBody", 7, LEVEL::WARN});
+    while (pairs.Put(FLogKey{"x"}) && pairs.Put(-1e300));
+
+    for (const auto format : {FLogOutputFormat::TEXT, FLogOutputFormat::JSON, FLogOutputFormat::RFC5424}){
+        FLogRecordRenderer renderer(format);
+        for (const auto& [data, length] : {std::pair{slot, record.Length()}, std::pair{keyed, pairs.Length()}}){
+            const std::size_t rendered = renderer.Render(data, length);
+            EXPECT_LE(rendered, FLogRecordRenderer::MAX_RENDERED_SIZE);
+            const std::string line(reinterpret_cast<const char*>(renderer.Data()), rendered);
+            EXPECT_EQ(line.back(), '\n');
+            // json fields print doubles in shortest form, they fit.
+            if (format != FLogOutputFormat::JSON || data != keyed){
+                EXPECT_NE(line.find("..."), std::string::npos);
+            }
+        }
+    }
+}
+TEST(FlashLoggerTest, LOG_RATE_LIMIT) {
+
+    FLogManager::globalInstance().SetLogLevel("INFO");
+
+    FLogOnce once;
+    FLogEveryN<10> everyTen;
+    FLogRateLimit<50> fiftyPerSecond;
+    int onceCount = 0, everyTenCount = 0, rateCount = 0;
+    for(unsigned int i = 0; i < 100; i++){
+
+        onceCount += once.Pass();
+        everyTenCount += everyTen.Pass();
+        rateCount += fiftyPerSecond.Pass();
+        FLOG_INFO_ONCE << "once";
+        FLOG_INFO_EVERY_N(10) << "every 10th: " << i;
+        FLOG_INFO_RATE(50) << "at most 50 per second: " << i;
+        FLOG_INFO_FMT_DEDUP("same line {}", i / 50);
+    }
+    EXPECT_EQ(onceCount, 1);
+    EXPECT_EQ(everyTenCount, 10);
+    EXPECT_EQ(rateCount, 50);
+
+    FLogDedup dedup;
+    std::uint32_t repeated = 0;
+    EXPECT_TRUE(dedup.Pass(FLogHashArgs("a", 1), repeated));
+    EXPECT_FALSE(dedup.Pass(FLogHashArgs("a", 1), repeated));
+    EXPECT_FALSE(dedup.Pass(FLogHashArgs("a", 1), repeated));
+    EXPECT_TRUE(dedup.Pass(FLogHashArgs("a", 2), repeated));
+    EXPECT_EQ(repeated, 2u);
+}
+TEST(FlashLoggerTest, LOG_DEDUP) {
+
+    // a site which repeats and goes quiet has its count written a second later, or at exit.
+    // rate_limit = 0 lets every line through.
+    auto read = [](){
+        std::ifstream file("./flog_dedup_test.txt");
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    auto count = [](const std::string& p_Log, const std::string& p_Text){
+        std::size_t n = 0;
+        for (auto at = p_Log.find(p_Text); at != std::string::npos; at = p_Log.find(p_Text, at + 1)) ++n;
+        return n;
+    };
+    for (const short rateLimit : {1, 0}){
+
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_dedup_test.txt";
+        data.size_of_ring_buffer = 16;
+        data.background_threads = 0;
+        data.rate_limit = rateLimit;
+        {
+            auto logger = MakeTestLogger(data);
+            FLogManager& flog = *logger;
+            flog.SetLogLevel("CRIT");
+            auto linkDown = [&flog](unsigned int p_Times){
+                for (unsigned int i = 0; i < p_Times; i++){
+
+                    (FLogLine() = flog.getFlogLineDeferred(LEVEL::CRIT))
+                        .FormatDedup(LEVEL::CRIT, __FUNCTION__, __LINE__, flog.LimitersEnabled(), FLOG_FMT_STRING("link {} down"), 7);
+                }
+            };
+            linkDown(5);
+            flog.Poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            auto done = flog.Flush();
+            while (done.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+                flog.Poll();
+            }
+            const std::string log = read();
+            EXPECT_EQ(count(log, "link 7 down"), rateLimit ? 1u : 5u);
+            EXPECT_EQ(count(log, "previous line repeated 4 times"), rateLimit ? 1u : 0u);
+            linkDown(3);
+        }
+        const std::string log = read();
+        EXPECT_EQ(count(log, "previous line repeated 3 times"), rateLimit ? 1u : 0u);
+        EXPECT_EQ(count(log, "previous line repeated"), rateLimit ? 2u : 0u);
+        std::remove("./flog_dedup_test.txt");
+    }
+}
+TEST(FlashLoggerTest, LOG_CATEGORY) {
+
+    FLogManager::globalInstance().SetLogLevel("CRIT");
+    FLogManager& audit = FLogManager::Category("audit");
+    ASSERT_NE(&audit, &FLogManager::globalInstance());
+    EXPECT_EQ(audit.Name(), "audit");
+    EXPECT_EQ(&FLogManager::Category("no_such_category"), &FLogManager::globalInstance());
+
+    // levels are per logger.
+    audit.SetLogLevel("INFO");
+    FLogManager::globalInstance().SetLogLevel("CRIT");
+    EXPECT_FALSE(audit.toLog(LEVEL::WARN));
+    EXPECT_TRUE(FLogManager::globalInstance().toLog(LEVEL::WARN));
+
+    for(unsigned int i = 0; i < 100; i++){
+
+        FLOG_INFO_TO("audit") << "audit line " << i;
+        FLOG_WARN_TO("audit") << "filtered by the audit level " << i;
+        FLOG_WARN << "global line " << i;
+    }
+    EXPECT_EQ(&FLOG_CATEGORY("audit"), &audit);
+}
+TEST(FlashLoggerTest, LOG_RELOAD) {
+
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.SetLogLevel("INFO");
+
+    flashlogger_config_data live;
+    live.log_level = "CRIT";
+    live.rate_limit = 0;
+    flog.ApplySettings(live);
+    EXPECT_TRUE(flog.toLog(LEVEL::WARN));
+    EXPECT_FALSE(flog.LimitersEnabled());
+    int passed = 0;
+    for(int i = 0; i < 10; i++){
+
+        passed += FLOG_SITE_PASS(LEVEL::INFO, FLogOnce);
+    }
+    EXPECT_EQ(passed, 10);
+
+    // back to what the config file says: limiters on, level untouched (log_level is empty).
+    flog.Reload();
+    EXPECT_TRUE(flog.LimitersEnabled());
+    EXPECT_TRUE(flog.toLog(LEVEL::WARN));
+    passed = 0;
+    for(int i = 0; i < 10; i++){
+
+        passed += FLOG_SITE_PASS(LEVEL::INFO, FLogOnce);
+    }
+    EXPECT_EQ(passed, 1);
+}
+TEST(FlashLoggerTest, LOG_BACKTRACE) {
+
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.SetLogLevel("INFO");
+    flashlogger_config_data live;
+    live.backtrace = 8;
+    flog.ApplySettings(live);
+
+    for(unsigned int i = 0; i < 20; i++){
+
+        FLOG_WARN << "kept for the backtrace " << i;
+    }
+    EXPECT_EQ(flog.DumpBacktrace(), 8u);
+    EXPECT_EQ(flog.DumpBacktrace(), 0u);
+
+    // every way of writing a line is captured, the CRIT line writes them and itself.
+    FLOG_WARN.kv("field", 1) << "kv";
+    FLOG_WARN_FMT("format {}", 2);
+    FLOG_CRIT << "backtrace trigger";
+    EXPECT_EQ(flog.DumpBacktrace(), 0u);
+
+    live.backtrace = 0;
+    flog.ApplySettings(live);
+    FLOG_WARN << "dropped, no backtrace";
+    EXPECT_EQ(flog.DumpBacktrace(), 0u);
+}
+
+TEST(FlashLoggerTest, LOG_FLUSH) {
+
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.SetLogLevel("CRIT");
+    for(unsigned int i = 0; i < 100; i++){
+
+        FLOG_INFO << "flushed line " << i;
+    }
+    auto flushed = flog.Flush();
+    auto synced = flog.Flush(true);
+    EXPECT_EQ(flushed.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(synced.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+    // nothing logged since: completes on the next consumer round.
+    EXPECT_EQ(flog.Flush(true).wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(FlashLoggerTest, LOG_POLL) {
+
+    // the suite runs with background threads, Poll must not race them.
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.SetLogLevel("CRIT");
+    FLOG_INFO << "drained by the consumer thread";
+    EXPECT_EQ(flog.Poll(), 0u);
+
+    // threadless: no thread of its own, Poll writes at most its budget and says how many.
+    auto threads = [](){
+        std::size_t n = 0;
+        for ([[maybe_unused]] const auto& task : std::filesystem::directory_iterator("/proc/self/task")) ++n;
+        return n;
+    };
+    const std::size_t before = threads();
+    {
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_poll_test.txt";
+        data.size_of_ring_buffer = 64;
+        data.background_threads = 0;
+        auto logger = MakeTestLogger(data);
+        FLogManager& threadless = *logger;
+        threadless.SetLogLevel("CRIT");
+        EXPECT_EQ(threads(), before);
+        threadless.Poll();
+        for (unsigned int i = 0; i < 20; i++){
+
+            FLOG_LINE(threadless, LEVEL::CRIT) << "polled line " << i;
+        }
+        std::size_t total = 0;
+        for (std::size_t written; (written = threadless.Poll(3)) != 0; total += written){
+
+            EXPECT_LE(written, 3u);
+        }
+        EXPECT_EQ(total, 20u);
+        auto done = threadless.Flush();
+        EXPECT_EQ(threadless.Poll(), 0u);
+        EXPECT_EQ(done.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+        std::ifstream file("./flog_poll_test.txt");
+        const std::string log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::size_t lines = 0;
+        for (auto at = log.find("polled line"); at != std::string::npos; at = log.find("polled line", at + 1)) ++lines;
+        EXPECT_EQ(lines, 20u);
+        EXPECT_EQ(threads(), before);
+    }
+    std::remove("./flog_poll_test.txt");
+}
+
+TEST(FlashLoggerTest, LOG_TRACE_SPAN) {
+
+    // the macros time through the global logger: spans on and back, nothing else changes.
+    FLogManager& global = FLogManager::globalInstance();
+    const bool tracing = global.TraceSpans();
+    global.SetTraceSpans(true);
+    EXPECT_GT(FLogTickClock::ToNanos(1000), 0.0);
+    for(unsigned int i = 0; i < 100; i++){
+
+        FLOG_SCOPE_TIMER("gtest_loop");
+        FLOG_TRACE_SPAN(inner, "gtest_inner");
+        inner.End();
+    }
+    global.SetTraceSpans(tracing);
+
+    // the record layout round trips.
+    alignas(8) std::uint8_t record[256];
+    FLogRecordWriter writer(record, sizeof(record));
+    writer.Put(FLogHeader{FLogNow(), "f", 1, LEVEL::INFO});
+    writer.Put(FLogSpan{"span", 42, 7});
+    FLogRecordReader reader(record, writer.Length());
+    FLogItem item;
+    ASSERT_TRUE(reader.Next(item) && reader.Next(item));
+    EXPECT_EQ(item.tag, FLogTag::SPAN);
+    EXPECT_EQ(item.str, "span");
+    EXPECT_EQ(item.ticks, 42u);
+    EXPECT_EQ(item.u32, 7u);
+
+    // a logger of its own: the span lines, the summary at exit and the trace file.
+    {
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_span_test.txt";
+        data.size_of_ring_buffer = 16;
+        data.background_threads = 0;
+        data.trace_spans = 1;
+        data.trace_file = "./flog_span_test.json";
+        auto logger = MakeTestLogger(data);
+        for (unsigned int i = 0; i < 3; i++){
+
+            logger->TraceSpan("gtest_span", FLogTickClock::Now() - 1000, "TestBody", 42);
+        }
+        logger->Poll();
+    }
+    auto read = [](const char* p_Path){
+        std::ifstream file(p_Path);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    auto count = [](const std::string& p_Text, const std::string& p_Part){
+        std::size_t n = 0;
+        for (auto at = p_Text.find(p_Part); at != std::string::npos; at = p_Text.find(p_Part, at + 1)) ++n;
+        return n;
+    };
+    const std::string log = read("./flog_span_test.txt");
+    EXPECT_EQ(count(log, "span=gtest_span ns="), 3u);
+    EXPECT_EQ(count(log, "FLogSpanSummary"), 1u);
+    EXPECT_EQ(count(log, "span=gtest_span count=3"), 1u);
+    const std::string trace = read("./flog_span_test.json");
+    EXPECT_EQ(trace.rfind("[\n{", 0), 0u);
+    EXPECT_EQ(trace.substr(trace.size() - 4), "}\n]\n");
+    EXPECT_EQ(count(trace, "{\"name\":\"gtest_span\",\"cat\":\"flog\",\"ph\":\"X\",\"ts\":"), 3u);
+    EXPECT_EQ(count(trace, "\"args\":{\"func\":\"TestBody\",\"line\":42}}"), 3u);
+    std::remove("./flog_span_test.txt");
+    std::remove("./flog_span_test.json");
+}
+
+TEST(FlashLoggerTest, LOG_SITE_PROFILE) {
+
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.SetLogLevel("WARN");
+    flashlogger_config_data live;
+    live.profile_sites = 1;
+    flog.ApplySettings(live);
+    const std::uint32_t noisy = __LINE__ + 3;
+    for(unsigned int i = 0; i < 500; i++){
+
+        FLOG_INFO << "the noisy site, the noisy site, the noisy site " << i;
+        FLOG_CRIT << "dropped at WARN";
+    }
+    ASSERT_EQ(flog.Flush().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+    // counts of other sites may add up when profile_sites is on from the start.
+    const auto report = FLogManager::SiteReport(SIZE_MAX);
+    auto site = [&report](std::uint32_t p_Line){
+        return std::find_if(report.begin(), report.end(), [p_Line](const FLogSiteReport& s){ return s.line == p_Line && s.function == "TestBody"; });
+    };
+    ASSERT_NE(site(noisy), report.end());
+    EXPECT_GE(site(noisy)->lines, 500u);
+    EXPECT_GT(site(noisy)->bytes, 500u * 40);
+    EXPECT_GT(site(noisy)->nanosPerCall, 0.0);
+    ASSERT_NE(site(noisy + 1), report.end());
+    EXPECT_GE(site(noisy + 1)->drops, 500u);
+    EXPECT_EQ(site(noisy + 1)->lines, 0u);
+
+    live.profile_sites = 0;
+    flog.ApplySettings(live);
+}
+
+TEST(FlashLoggerTest, LOG_INDEX) {
+
+    const std::string path = "./flog_index_test.idx";
+    {
+        FLogIndexWriter index;
+        ASSERT_TRUE(index.Open(path, 2));
+        index.Add(5000000, LEVEL::INFO, "OnFill", 10, 0, 40);
+        index.Add(5000100, LEVEL::CRIT, "OnFill", 11, 40, 80);
+        index.Add(5000200, LEVEL::INFO, "OnFill", 10, 80, 120);     // block full
+        index.Add(6000000, LEVEL::INFO, "OnQuote", 20, 120, 160);   // new second
+    }
+    const auto blocks = FLogReadIndex(path);
+    std::remove(path.c_str());
+    ASSERT_EQ(blocks.size(), 3u);
+    EXPECT_EQ(blocks[0].offset, 0u);
+    EXPECT_EQ(blocks[0].end, 80u);
+    EXPECT_EQ(blocks[0].records, 2u);
+    EXPECT_EQ(blocks[0].levels, (1u << static_cast<unsigned>(LEVEL::INFO)) | (1u << static_cast<unsigned>(LEVEL::CRIT)));
+    EXPECT_EQ(blocks[1].firstMicros, 5000200u);
+    EXPECT_EQ(blocks[2].offset, 120u);
+    const std::uint64_t onFill = FLogIndexKeys::Function("OnFill");
+    EXPECT_TRUE(FLogIndexKeys::Test(blocks[0].sites, FLogIndexKeys::Site(onFill, 11)));
+    EXPECT_TRUE(FLogIndexKeys::Test(blocks[1].sites, onFill));
+}
+
+TEST(FlashLoggerTest, LOG_SOCKET) {
+
+    const std::string path = "./flog_socket_test.sock";
+    unlink(path.c_str());
+    const int receiver = socket(AF_UNIX, SOCK_DGRAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(bind(receiver, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)), 0);
+    int small = 4096;
+    setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    const std::size_t total = 5000;
+    std::size_t received = 0;
+    char buffer[256];
+    auto drain = [&](){
+        while (recv(receiver, buffer, sizeof(buffer), MSG_DONTWAIT) > 0){
+            EXPECT_EQ(std::string(buffer, 7), "record ");
+            ++received;
+        }
+    };
+    {
+        // nobody reads: the kernel takes what fits, 64KB (the minimum) are queued, the rest is dropped.
+        FLogSocketWritter sink("unix:" + path, 0);
+        for (std::size_t i = 0; i < total; ++i){
+            const std::string record = "record " + std::to_string(i) + " of the socket sink test\n";
+            sink.WriteToFile(reinterpret_cast<const std::uint8_t*>(record.data()), record.size());
+        }
+        EXPECT_GT(sink.Dropped(), 0u);
+        EXPECT_LE(sink.Queued(), FLogSocketWritter::BATCH_BYTES);
+        for (int i = 0; i < 1000 && !sink.Flush(); ++i){
+            drain();
+        }
+        EXPECT_TRUE(sink.Flush());
+        drain();
+        EXPECT_EQ(received + sink.Dropped(), total);
+        EXPECT_LT(sink.Syscalls(), total / 4);
+    }
+    close(receiver);
+    unlink(path.c_str());
+}
+
+// a collector which takes 50us per line.
+struct FLogSlowTestSink{
+
+    static constexpr const char* NAME{"slow"};
+    template<typename CONFIG>
+    static auto ConfigArgs(const CONFIG&){ return std::make_tuple(); }
+
+    bool WriteToFile(const std::uint8_t* data, int size){
+
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        sCrit += std::string_view(reinterpret_cast<const char*>(data), size).find("CRIT") != std::string_view::npos;
+        ++sLines;
+        return true;
+    }
+    bool Flush(){ return true; }
+    void Idle(){ }
+    int Fd() const noexcept{ return -1; }
+    std::uint64_t Offset() const noexcept{ return 0; }
+    int FlushForCrash() noexcept{ return STDERR_FILENO; }
+
+    static inline std::atomic<std::size_t> sLines{0};
+    static inline std::atomic<std::size_t> sCrit{0};
+};
+
+TEST(FlashLoggerTest, LOG_SINKS) {
+
+    flashlogger_config_data data;
+    data.log_file_path = ".";
+    data.log_file_name = "flog_sinks_test.txt";
+    data.sink_queue_kb = 64;
+    std::uint64_t dropped = 0;
+    {
+        FLogWritter<FLogFileWritter, FLogSlowTestSink> sinks(data);
+        sinks.SetLevels("slow:WARN");
+        const std::string padding(180, '.');
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < 1000; i++){
+
+            const std::string warn = "WARN " + std::to_string(i) + padding + "\n";
+            const std::string crit = "CRIT " + std::to_string(i) + padding + "\n";
+            sinks.Write(LEVEL::WARN, reinterpret_cast<const std::uint8_t*>(warn.data()), warn.size());
+            sinks.Write(LEVEL::CRIT, reinterpret_cast<const std::uint8_t*>(crit.data()), crit.size());
+        }
+        // 1000 lines at 50us each would take 50ms written inline.
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+        dropped = sinks.Dropped();
+        EXPECT_GT(dropped, 0u);
+
+        // the lane acknowledges a flush once what it queued before is written.
+        sinks.Flush();
+        while (!sinks.LanesFlushed(sinks.Flushes())){
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        EXPECT_EQ(FLogSlowTestSink::sLines + dropped, 1000u);
+    }
+    EXPECT_EQ(FLogSlowTestSink::sLines + dropped, 1000u);
+    EXPECT_EQ(FLogSlowTestSink::sCrit, 0u);
+
+    std::ifstream file("./flog_sinks_test.txt");
+    EXPECT_EQ(std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n'), 2000);
+    std::remove("./flog_sinks_test.txt");
+}
+
+TEST(FlashLoggerTest, LOG_CODEC) {
+
+    // three call sites, 600 lines: the dictionary keeps one line of each.
+    std::string lines;
+    FLogCodecDictionary dictionary(500);
+    for (unsigned int i = 0; i < 600; i++){
+
+        const std::string line = "[ Mon Oct 19 11:55:25 2026 micro-seconds: " + std::to_string(100000 + i * 7) + " ][ OnFill : " +
+                                 std::to_string(40 + i % 3) + " ] order_id=" + std::to_string(i * 13) + " px=101.25 filled \n";
+        dictionary.Feed(reinterpret_cast<const std::uint8_t*>(line.data()), line.size());
+        lines += line;
+    }
+    ASSERT_TRUE(dictionary.Complete());
+    EXPECT_NE(dictionary.Id(), 0u);
+    EXPECT_EQ(std::count(dictionary.Content().begin(), dictionary.Content().end(), '\n'), 3);
+
+    for (FLogCodec codec : {FLogCodec::ZLIB, FLogCodec::LZ4, FLogCodec::ZSTD}){
+
+        if (!FLogCodecAvailable(codec)) continue;
+        FLogBlockEncoder encoder(codec);
+        encoder.SetDictionary(&dictionary.Content());
+        std::string block, decoded;
+        ASSERT_EQ(encoder.Encode(reinterpret_cast<const std::uint8_t*>(lines.data()), lines.size(), block), codec);
+        EXPECT_LT(block.size() * 4, lines.size());
+
+        FLogBlockDecoder decoder;
+        EXPECT_FALSE(decoder.Decode(codec, dictionary.Id(), block.data(), block.size(), lines.size(), decoded));
+        decoder.AddDictionary(dictionary.Id(), dictionary.Content());
+        ASSERT_TRUE(decoder.Decode(codec, dictionary.Id(), block.data(), block.size(), lines.size(), decoded));
+        EXPECT_EQ(decoded, lines);
+    }
+
+    // incompressible or no codec: sent as is.
+    FLogBlockEncoder none(FLogCodec::NONE);
+    std::string block;
+    EXPECT_EQ(none.Encode(reinterpret_cast<const std::uint8_t*>(lines.data()), 64, block), FLogCodec::NONE);
+    EXPECT_EQ(block, lines.substr(0, 64));
+}
+
+TEST(FlashLoggerTest, LOG_FORMATTERS) {
+
+    // batches come back in submit order whichever formatter finishes first.
+    FLogFormatterPool pool(3, FLogOutputFormat::TEXT);
+    alignas(8) std::uint8_t slot[256];
+    unsigned int next = 0, expected = 0;
+    std::string out;
+    while (expected < 2000){
+
+        while (next < 2000){
+            FLogFormatterPool::Batch* batch = pool.Acquire();
+            if (!batch) break;
+            for (std::size_t i = 0; i < FLogFormatterPool::BATCH_RECORDS && next < 2000; ++i, ++next){
+                FLogRecordWriter record(slot, sizeof(slot));
+                record.Put(FLogHeader{FLogNow(), "OnFill", 10, LEVEL::INFO});
+                record.Put(next);
+                batch->Add(slot, record.Length());
+            }
+            pool.Submit(batch);
+        }
+        while (FLogFormatterPool::Batch* batch = pool.Front()){
+            std::size_t length = 0;
+            for (std::size_t i = 0; i < batch->Count(); ++i, ++expected){
+                const std::uint8_t* line = batch->Rendered(i, length);
+                out.assign(reinterpret_cast<const char*>(line), length);
+                ASSERT_NE(out.find("]" + std::to_string(expected) + " "), std::string::npos) << out;
+            }
+            pool.PopFront();
+        }
+    }
+    EXPECT_TRUE(pool.Empty());
+}
+
+TEST(FlashLoggerTest, LOG_WARM_UP) {
+
+    alignas(8) std::uint8_t slot[256];
+    FLogRecordWriter warmUp(slot, sizeof(slot));
+    warmUp.Put(FLogHeader{FLogNow(), "FLogWarmUp", FLOG_WARM_UP_LINE, LEVEL::INFO});
+    EXPECT_TRUE(FLogIsWarmUpRecord(slot, warmUp.Length()));
+    FLogRecordWriter line(slot, sizeof(slot));
+    line.Put(FLogHeader{FLogNow(), "OnFill", 10, LEVEL::INFO});
+    EXPECT_FALSE(FLogIsWarmUpRecord(slot, line.Length()));
+
+    // warm up lines are consumed and counted as written, Flush() sees them through.
+    FLogManager& flog = FLogManager::globalInstance();
+    flog.WarmUp();
+    std::thread([&flog](){ flog.PrepareThread(); FLOG_INFO << "after warm up"; }).join();
+    EXPECT_EQ(flog.Flush().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(FlashLoggerTest, LOG_CAPTURE) {
+
+    // shapes, not values: a replay sees the same sites, threads, messages and string lengths.
+    {
+        FLogCaptureWriter capture;
+        ASSERT_TRUE(capture.Open("./flog_capture_test.bin"));
+        for (unsigned int i = 0; i < 3; i++){
+
+            capture.Add(ProducerMsg(false, {FLogHeader{FLogNow(), "OnFill", 10, LEVEL::WARN}}));
+            capture.Add(ProducerMsg(false, {FLogKey{"order_id"}, i}));
+            capture.Add(ProducerMsg(false, {" ", "filled", -1, 2.5}));
+            capture.Add(ProducerMsg(true, {}));
+        }
+        capture.Add(ProducerMsg(false, {FLogHeader{FLogNow(), "FLogWarmUp", FLOG_WARM_UP_LINE, LEVEL::INFO}}));
+        capture.Add(ProducerMsg(true, {}));
+        EXPECT_EQ(capture.Lines(), 3u);
+    }
+
+    FLogCaptureReader reader;
+    ASSERT_TRUE(reader.Open("./flog_capture_test.bin"));
+    FLogCaptureLine line;
+    std::uint64_t lines = 0, last = 0;
+    std::array<FLogCaptureItem, 8> items;
+    while (reader.Next(line)){
+
+        ++lines;
+        EXPECT_GE(line.nanos, last);
+        last = line.nanos;
+        EXPECT_EQ(line.tid, FLogThreadId());
+        ASSERT_NE(reader.Site(line.site), nullptr);
+        EXPECT_EQ(reader.Site(line.site)->function, "OnFill");
+        EXPECT_EQ(reader.Site(line.site)->level, LEVEL::WARN);
+        ASSERT_EQ(line.messages, 4u);
+        std::string_view shape = line.shape;
+        EXPECT_EQ(FLogCaptureReader::Message(shape, items), 1);
+        EXPECT_EQ(items[0].tag, FLogTag::HEADER);
+        EXPECT_EQ(FLogCaptureReader::Message(shape, items), 2);
+        EXPECT_EQ(items[0].tag, FLogTag::KEY);
+        EXPECT_EQ(items[0].length, 8u);
+        EXPECT_EQ(items[1].tag, FLogTag::U32);
+        EXPECT_EQ(FLogCaptureReader::Message(shape, items), 4);
+        EXPECT_EQ(items[1].length, 6u);
+        EXPECT_EQ(items[3].tag, FLogTag::F64);
+        EXPECT_EQ(FLogCaptureReader::Message(shape, items), 0);
+        EXPECT_TRUE(shape.empty());
+    }
+    EXPECT_EQ(lines, 3u);
+
+    // site ids are 1 based, a site 0 is a corrupt trace.
+    std::ofstream("./flog_capture_test.bin", std::ios::binary) << std::string(FLogCaptureCodec::MAGIC, sizeof(FLogCaptureCodec::MAGIC))
+                                                              << std::string("S\0\7\0\1f", 6);
+    FLogCaptureReader corrupt;
+    ASSERT_TRUE(corrupt.Open("./flog_capture_test.bin"));
+    EXPECT_FALSE(corrupt.Next(line));
+    std::remove("./flog_capture_test.bin");
+}
+
+TEST(FlashLoggerTest, LOG_SPILL) {
+
+    // committed ring slots are contiguous from the read position.
+    FLogCircularBuffer<FLogLine> ring(8);
+    for (unsigned int i = 0; i < 3; i++){
+
+        ring.WriteData(ProducerMsg(true, {"line ", i}));
+    }
+    EXPECT_TRUE(ring.Holds(3));
+    EXPECT_FALSE(ring.Holds(4));
+
+    // records come back in order across the wrap of the file, a full file refuses.
+    FLogSpillFile spill;
+    ASSERT_TRUE(spill.Open("./flog_spill_test.bin", 0));
+    EXPECT_FALSE(std::ifstream("./flog_spill_test.bin").good());
+    std::uint8_t record[256];
+    std::uint64_t pushed = 0, popped = 0;
+    const std::uint8_t* front = nullptr;
+    std::size_t length = 0;
+    for (unsigned int round = 0; round < 3; round++){
+
+        while (true){
+            std::memset(record, static_cast<int>(pushed & 0xFF), sizeof(record));
+            if (!spill.Push(record, 100 + pushed % 150)) break;
+            ++pushed;
+        }
+        EXPECT_GT(spill.Full(), 0u);
+        // drain two thirds, the next round wraps.
+        const std::uint64_t target = popped + (pushed - popped) * 2 / 3;
+        while (popped < target && spill.Front(front, length)){
+            ASSERT_EQ(length, 100 + popped % 150);
+            ASSERT_EQ(front[length - 1], static_cast<std::uint8_t>(popped & 0xFF));
+            spill.PopFront();
+            ++popped;
+        }
+    }
+    EXPECT_EQ(spill.ForEach([](const std::uint8_t*, std::size_t){}), pushed - popped);
+    while (spill.Front(front, length)){
+        ASSERT_EQ(length, 100 + popped % 150);
+        spill.PopFront();
+        ++popped;
+    }
+    EXPECT_EQ(popped, pushed);
+    EXPECT_TRUE(spill.Empty());
+}
+
+TEST(FlashLoggerTest, LOG_SPILL_FULL) {
+
+    // background_threads = 0 and Poll(1): the ring is spilled each round until the file is full,
+    // then only the file's front reaches the sink. every line comes out once, in order.
+    constexpr unsigned int ROUNDS = 600, LINES = 64;
+    const std::string padding(150, 'x');
+    {
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_spill_full_test.txt";
+        data.size_of_ring_buffer = 64;
+        data.background_threads = 0;
+        data.spill_file = "./flog_spill_full_test.bin";
+        data.spill_mb = 0;
+        auto logger = MakeTestLogger(data);
+        FLogManager& flog = *logger;
+        flog.SetLogLevel("CRIT");
+        for (unsigned int round = 0; round < ROUNDS; round++){
+
+            for (unsigned int i = 0; i < LINES; i++){
+
+                FLOG_LINE(flog, LEVEL::INFO) << "spill line " << round * LINES + i << " " << padding.c_str();
+            }
+            flog.Poll(1);
+        }
+        while (flog.Poll(1024)){}
+    }
+
+    std::ifstream file("./flog_spill_full_test.txt");
+    const std::string log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<unsigned int> seen(ROUNDS * LINES, 0);
+    unsigned long next = 0;
+    bool ordered = true;
+    for (auto at = log.find("spill line "); at != std::string::npos; at = log.find("spill line ", at + 1)){
+        const unsigned long line = std::strtoul(log.c_str() + at + 11, nullptr, 10);
+        ASSERT_LT(line, seen.size());
+        ++seen[line];
+        ordered = ordered && line == next++;
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), 1u), static_cast<std::ptrdiff_t>(seen.size()));
+    std::remove("./flog_spill_full_test.txt");
+    std::remove("./flog_spill_full_test.bin");
+}
+
+TEST(FlashLoggerTest, LOG_SHM_FALLBACK) {
+
+    // shm_open refuses a name with a slash: the logger writes its own lines instead.
+    {
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_shm_test.txt";
+        data.size_of_ring_buffer = 8;
+        data.background_threads = 0;
+        data.shm_name = "no/such/dir";
+        auto logger = MakeTestLogger(data);
+        FLogManager& flog = *logger;
+        flog.SetLogLevel("CRIT");
+        FLOG_LINE(flog, LEVEL::CRIT) << "heap ring line";
+        flog.Poll();
+    }
+    std::ifstream file("./flog_shm_test.txt");
+    const std::string log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(log.find("heap ring line"), std::string::npos);
+    std::remove("./flog_shm_test.txt");
+}
+
+TEST(FlashLoggerTest, LOG_CRASH) {
+
+    // a fresh process: the statement runs in a re-executed copy of this binary, which starts
+    // no suite logger (see RunGTest) and has no thread of the suite. background_threads = 0:
+    // lines stay where Poll leaves them.
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    std::remove("./flog_crash_test.txt");
+    EXPECT_EXIT({
+        flashlogger_config_data data{};
+        data.log_file_path = ".";
+        data.log_file_name = "flog_crash_test.txt";
+        data.size_of_ring_buffer = 64;
+        data.crash_handler = 1;
+        data.background_threads = 0;
+        auto logger = MakeTestLogger(data);
+        FLogManager& flog = *logger;
+        flog.SetLogLevel("CRIT");
+        // through the sink into the file stream's buffer, then committed to the ring, then in the box.
+        FLOG_LINE(flog, LEVEL::INFO) << "sink line";
+        flog.Poll(1);
+        for (unsigned int i = 0; i < 5; i++){
+
+            FLOG_LINE(flog, LEVEL::INFO) << "ring line " << i;
+        }
+        flog.Poll(0);
+        for (unsigned int i = 0; i < 5; i++){
+
+            FLOG_LINE(flog, LEVEL::INFO) << "box line " << i;
+        }
+        std::abort();
+    }, testing::KilledBySignal(SIGABRT), "");
+
+    std::ifstream file("./flog_crash_test.txt");
+    const std::string log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto count = [&log](const std::string& p_Text){
+        std::size_t n = 0;
+        for (auto at = log.find(p_Text); at != std::string::npos; at = log.find(p_Text, at + 1)) ++n;
+        return n;
+    };
+    EXPECT_EQ(count("sink line"), 1u);
+    EXPECT_EQ(count("ring line"), 5u);
+    EXPECT_EQ(count("box line"), 5u);
+    EXPECT_LT(log.find("ring line"), log.find("box line"));
+    EXPECT_EQ(count("FLog crashed on signal 6, lines flushed: 10*"), 1u);
+    std::remove("./flog_crash_test.txt");
+}
 
 int RunGTest(int argc, char **argv, auto&& p_Config) {
 
-    FLogManager& flog_service = FLogManager::globalInstance(std::move(p_Config));
-    flog_service.SetCopyrightAndStartService(s_copyright);
-    FLogManager::SetLogGranularity("FULL");
+    // a death test child runs one statement with loggers of its own: the suite's global logger
+    // would truncate the files of the parent run.
+    const bool deathTestChild = std::any_of(argv, argv + argc, [](const char* p_Arg){
+        return std::string_view(p_Arg).rfind("--gtest_internal_run_death_test", 0) == 0;
+    });
     testing::InitGoogleTest(&argc, argv);
+    if (!deathTestChild){
+        FLogManager& flog_service = FLogManager::globalInstance(std::move(p_Config));
+        flog_service.SetCopyrightAndStartService(s_copyright);
+        flog_service.SetLogGranularity("FULL");
+    }
     return RUN_ALL_TESTS();
 }
@@ -32,20 +32,11 @@
 #include "./include/gtest.h"
 #include "./include/FLogManager.h"
 
-LEVEL FLogManager::mCurrentLevel = LEVEL::CRIT;
-GRANULARITY FLogManager::mCurrentGranularity = GRANULARITY::FULL;
-
 int main(int argc, char *argv[])
 {
     //Input: FlashLogger <size_of_ring_buffer> <log_file_path> <log_file_name>
     std::unique_ptr<FLogConfig> config = std::make_unique<FLogConfig>([](flashlogger_config_data &d, boost::program_options::options_description &desc){
-        desc.add_options()
-                ("FlashLogger.size_of_ring_buffer", boost::program_options::value<short>(&d.size_of_ring_buffer)->default_value(50), "size of buffer to log asyncoronously")
-                ("FlashLogger.log_file_path", boost::program_options::value<std::string>(&d.log_file_path)->default_value("../"), "log file path")
-                ("FlashLogger.log_file_name", boost::program_options::value<std::string>(&d.log_file_name)->default_value("flashlog.txt"), "log file name")
-                ("FlashLogger.run_test", boost::program_options::value<short>(&d.run_test)->default_value(1), "choose to run test")
-                ("FlashLogger.server_ip", boost::program_options::value<std::string>(&d.server_ip)->default_value("localhost"), "microservice server IP")
-                ("FlashLogger.server_port", boost::program_options::value<std::string>(&d.server_port)->default_value("50051"), "microservice server port");
+        add_flashlogger_options(d, desc);
     });
 
     try {